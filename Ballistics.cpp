@@ -0,0 +1,111 @@
+#include "Ballistics.h"
+#include <cmath>
+
+// Fixed-point iterations on the flight time; converges in a few steps for
+// targets slower than the projectile
+const int INTERCEPT_ITERATIONS = 6;
+
+// Direction and flight time to a fixed point, continuous time from the origin
+static bool SolveStatic(float dx, float dy, float speed, float gravity, float& dirX, float& dirY, float& time)
+{
+    float distance = sqrtf(dx * dx + dy * dy);
+    if (distance <= 0.0f) return false;
+
+    float horizontal = fabsf(dx);
+    if (gravity <= 0.0f || horizontal < 1e-3f) {
+        // Straight line; also used for targets directly above or below
+        dirX = dx / distance;
+        dirY = dy / distance;
+        time = distance / speed;
+        return true;
+    }
+
+    // Low arc: tan(theta) = (s^2 - sqrt(s^4 - g (g x^2 + 2 h s^2))) / (g x), h measured upwards
+    float speedSq = speed * speed;
+    float height = -dy;
+    float discriminant = speedSq * speedSq - gravity * (gravity * horizontal * horizontal + 2.0f * height * speedSq);
+    if (discriminant < 0.0f) return false;
+
+    float tangent = (speedSq - sqrtf(discriminant)) / (gravity * horizontal);
+    float invLength = 1.0f / sqrtf(1.0f + tangent * tangent);
+    dirX = (dx > 0.0f ? 1.0f : -1.0f) * invLength;
+    dirY = -tangent * invLength;
+    time = horizontal / (speed * invLength);
+    return true;
+}
+
+bool SolveIntercept(float originX, float originY, float muzzleOffset,
+                    float targetX, float targetY, float targetVx, float targetVy,
+                    float speed, float gravity,
+                    float& dirX, float& dirY, float& flightTime)
+{
+    // Start from a direct aim; each iteration refines the muzzle position the
+    // projectile appears at and the lead on the target for the new flight time
+    float dx = targetX - originX;
+    float dy = targetY - originY;
+    float distance = sqrtf(dx * dx + dy * dy);
+    if (distance > 0.0f) {
+        dirX = dx / distance;
+        dirY = dy / distance;
+    }
+
+    float time = 0.0f;
+    bool solved = false;
+    for (int i = 0; i < INTERCEPT_ITERATIONS; i++)
+    {
+        float muzzleX = originX + muzzleOffset * dirX;
+        float muzzleY = originY + muzzleOffset * dirY;
+        float aimX = targetX + targetVx * time;
+        float aimY = targetY + targetVy * time;
+
+        float newDirX, newDirY, newTime;
+        if (!SolveStatic(aimX - muzzleX, aimY - muzzleY, speed, gravity, newDirX, newDirY, newTime)) {
+            solved = false;
+            break;
+        }
+        solved = true;
+
+        bool converged = fabsf(newTime - time) < 0.25f;
+        dirX = newDirX;
+        dirY = newDirY;
+        time = newTime;
+        if (converged && i > 0) break;
+    }
+
+    if (!solved) {
+        // Out of range: fall back to aiming straight at the target
+        if (distance > 0.0f) {
+            dirX = dx / distance;
+            dirY = dy / distance;
+        }
+        flightTime = distance / speed;
+        return false;
+    }
+
+    flightTime = time;
+    return true;
+}
+
+bool AimWithCache(AimSolution& cache, uint64_t tick,
+                  float originX, float originY, float muzzleOffset,
+                  float targetX, float targetY, float targetVx, float targetVy,
+                  float speed, float gravity, float tolerance)
+{
+    if (cache.valid) {
+        // Where the cached solution expects the target to be by now
+        float elapsed = (float)(tick - cache.solveTick);
+        float dx = targetX - (cache.targetX + cache.targetVx * elapsed);
+        float dy = targetY - (cache.targetY + cache.targetVy * elapsed);
+        if (dx * dx + dy * dy <= tolerance * tolerance) return false;
+    }
+
+    SolveIntercept(originX, originY, muzzleOffset, targetX, targetY, targetVx, targetVy,
+                   speed, gravity, cache.dirX, cache.dirY, cache.flightTime);
+    cache.valid = true;
+    cache.solveTick = tick;
+    cache.targetX = targetX;
+    cache.targetY = targetY;
+    cache.targetVx = targetVx;
+    cache.targetVy = targetVy;
+    return true;
+}
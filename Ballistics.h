@@ -0,0 +1,36 @@
+// Ballistics.h
+#pragma once
+
+#include <cstdint>
+
+// Cached lead-targeting solution for one cannon
+struct AimSolution {
+    bool valid;
+    uint64_t solveTick; // Tick the solution was computed on
+    float targetX;      // Target position at solveTick
+    float targetY;
+    float targetVx;     // Target velocity assumed by the solution
+    float targetVy;
+    float dirX;         // Unit launch direction
+    float dirY;
+    float flightTime;   // Ticks from launch to intercept
+};
+
+// Launch direction for a projectile of the given speed, fired from (originX, originY)
+// with muzzleOffset units of barrel along the direction, to meet a target moving
+// at constant velocity. Gravity pulls towards +y in units per tick squared; with
+// gravity the low arc is chosen. Returns false when the target is out of range,
+// leaving a direct aim at its current position in dirX/dirY.
+bool SolveIntercept(float originX, float originY, float muzzleOffset,
+                    float targetX, float targetY, float targetVx, float targetVy,
+                    float speed, float gravity,
+                    float& dirX, float& dirY, float& flightTime);
+
+// Reuses the cached solution while the target stays within tolerance of where
+// the solution predicted it would be, otherwise solves again.
+// Returns true when a new solution was computed. The direction only intercepts
+// for a launch on solveTick, so it suits a drawn barrel but not a later shot.
+bool AimWithCache(AimSolution& cache, uint64_t tick,
+                  float originX, float originY, float muzzleOffset,
+                  float targetX, float targetY, float targetVx, float targetVy,
+                  float speed, float gravity, float tolerance);
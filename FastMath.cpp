@@ -0,0 +1,97 @@
+#include "FastMath.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FASTMATH_SSE2
+#include <emmintrin.h>
+#endif
+
+void FastSinCosBatch(const float* angles, float* sines, float* cosines, size_t count)
+{
+    size_t i = 0;
+
+#ifdef FASTMATH_SSE2
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i oneBit = _mm_set1_epi32(1);
+    const __m128i twoBit = _mm_set1_epi32(2);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 angle = _mm_loadu_ps(angles + i);
+
+        // Round to nearest quadrant, ties away from zero like the scalar path
+        __m128 scaled = _mm_mul_ps(angle, _mm_set1_ps(FASTMATH_TWO_OVER_PI));
+        __m128 bias = _mm_or_ps(_mm_and_ps(scaled, _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000))), half);
+        __m128i j = _mm_cvttps_epi32(_mm_add_ps(scaled, bias));
+        __m128 jf = _mm_cvtepi32_ps(j);
+
+        __m128 r = _mm_sub_ps(angle, _mm_mul_ps(jf, _mm_set1_ps(FASTMATH_PIO2_1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(FASTMATH_PIO2_2)));
+        r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(FASTMATH_PIO2_3)));
+        __m128 r2 = _mm_mul_ps(r, r);
+
+        __m128 s = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f), _mm_mul_ps(r2, _mm_set1_ps(-1.9515295891e-4f)));
+        s = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(r2, s));
+        s = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), s));
+
+        __m128 c = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f), _mm_mul_ps(r2, _mm_set1_ps(2.443315711809948e-5f)));
+        c = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(r2, c));
+        c = _mm_add_ps(_mm_sub_ps(one, _mm_mul_ps(half, r2)), _mm_mul_ps(_mm_mul_ps(r2, r2), c));
+
+        // Quadrant: odd swaps sine and cosine, then fix up the signs
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, oneBit), oneBit));
+        __m128 sine = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+        __m128 cosine = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+        __m128i sineSign = _mm_slli_epi32(_mm_and_si128(j, twoBit), 30);
+        __m128i cosineSign = _mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, oneBit), twoBit), 30);
+
+        _mm_storeu_ps(sines + i, _mm_xor_ps(sine, _mm_castsi128_ps(sineSign)));
+        _mm_storeu_ps(cosines + i, _mm_xor_ps(cosine, _mm_castsi128_ps(cosineSign)));
+    }
+#endif
+
+    for (; i < count; i++) FastSinCos(angles[i], sines[i], cosines[i]);
+}
+
+void FastAtan2Batch(const float* y, const float* x, float* angles, size_t count)
+{
+    size_t i = 0;
+
+#ifdef FASTMATH_SSE2
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 ax = _mm_andnot_ps(signMask, vx);
+        __m128 ay = _mm_andnot_ps(signMask, vy);
+        __m128 mx = _mm_max_ps(ax, ay);
+        __m128 mn = _mm_min_ps(ax, ay);
+
+        // 0 / 0 lanes divide by one instead, giving a = 0 like the scalar path
+        __m128 valid = _mm_cmpneq_ps(mx, zero);
+        __m128 a = _mm_div_ps(mn, _mm_or_ps(_mm_and_ps(valid, mx), _mm_andnot_ps(valid, _mm_set1_ps(1.0f))));
+        __m128 s = _mm_mul_ps(a, a);
+
+        __m128 r = _mm_add_ps(_mm_set1_ps(0.05265332f), _mm_mul_ps(s, _mm_set1_ps(-0.01172120f)));
+        r = _mm_add_ps(_mm_set1_ps(-0.11643287f), _mm_mul_ps(s, r));
+        r = _mm_add_ps(_mm_set1_ps(0.19354346f), _mm_mul_ps(s, r));
+        r = _mm_add_ps(_mm_set1_ps(-0.33262347f), _mm_mul_ps(s, r));
+        r = _mm_add_ps(_mm_set1_ps(0.99997726f), _mm_mul_ps(s, r));
+        r = _mm_mul_ps(a, r);
+
+        __m128 steep = _mm_cmpgt_ps(ay, ax);
+        r = _mm_or_ps(_mm_and_ps(steep, _mm_sub_ps(_mm_set1_ps(FASTMATH_HALF_PI), r)), _mm_andnot_ps(steep, r));
+        // Sign bits, not comparisons, so -0 picks the same quadrant as the scalar path
+        __m128 left = _mm_castsi128_ps(_mm_srai_epi32(_mm_castps_si128(vx), 31));
+        r = _mm_or_ps(_mm_and_ps(left, _mm_sub_ps(_mm_set1_ps(FASTMATH_PI), r)), _mm_andnot_ps(left, r));
+        r = _mm_xor_ps(r, _mm_and_ps(vy, signMask));
+
+        _mm_storeu_ps(angles + i, r);
+    }
+#endif
+
+    for (; i < count; i++) angles[i] = FastAtan2(y[i], x[i]);
+}
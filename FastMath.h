@@ -0,0 +1,77 @@
+// FastMath.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Polynomial trigonometry for aiming, spawning and effects.
+// Error bounds against libm, measured over the stated ranges:
+//   FastSinCos: |error| < 2e-7 for |angle| <= 1000 radians
+//   FastAtan2:  |error| < 2e-6 radians for all finite inputs, signed zeros
+//               and the quadrant of (+-0, +-0) handled as atan2f does
+// The batch versions use SSE2 four lanes at a time when available and give
+// bit-identical results to the scalar ones. FastMathTest.cpp checks all of this.
+
+// Cody-Waite split of pi/2 so the quadrant reduction stays exact
+#define FASTMATH_TWO_OVER_PI 0.636619772f
+#define FASTMATH_PIO2_1 1.5703125f
+#define FASTMATH_PIO2_2 4.837512969970703125e-4f
+#define FASTMATH_PIO2_3 7.54978995489188216e-8f
+#define FASTMATH_HALF_PI 1.57079632679f
+#define FASTMATH_PI 3.14159265359f
+
+inline float FastMathFlipSign(float value, uint32_t signBit)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits ^= signBit;
+    memcpy(&value, &bits, sizeof(bits));
+    return value;
+}
+
+inline void FastSinCos(float angle, float& sine, float& cosine)
+{
+    // Reduce to r in [-pi/4, pi/4] and quadrant q
+    float jf = angle * FASTMATH_TWO_OVER_PI;
+    int j = (int)(jf >= 0.0f ? jf + 0.5f : jf - 0.5f);
+    jf = (float)j;
+    float r = ((angle - jf * FASTMATH_PIO2_1) - jf * FASTMATH_PIO2_2) - jf * FASTMATH_PIO2_3;
+    float r2 = r * r;
+
+    // Minimax polynomials on [-pi/4, pi/4]
+    float s = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f + r2 * -1.9515295891e-4f));
+    float c = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+    uint32_t q = (uint32_t)j & 3;
+    sine = FastMathFlipSign((q & 1) ? c : s, (q & 2) << 30);
+    cosine = FastMathFlipSign((q & 1) ? s : c, ((q + 1) & 2) << 30);
+}
+
+inline float FastAtan2(float y, float x)
+{
+    // Signs come from the sign bits so -0 behaves like libm: atan2(-0, -1) = -pi
+    uint32_t xSign, ySign;
+    memcpy(&xSign, &x, sizeof(xSign));
+    memcpy(&ySign, &y, sizeof(ySign));
+    xSign &= 0x80000000u;
+    ySign &= 0x80000000u;
+
+    float ax = FastMathFlipSign(x, xSign);
+    float ay = FastMathFlipSign(y, ySign);
+    float mx = ax > ay ? ax : ay;
+    float mn = ax > ay ? ay : ax;
+
+    // atan(a) on [0, 1]; a = 0 when both inputs are zero
+    float a = mx > 0.0f ? mn / mx : 0.0f;
+    float s = a * a;
+    float r = a * (0.99997726f + s * (-0.33262347f + s * (0.19354346f + s * (-0.11643287f + s * (0.05265332f + s * -0.01172120f)))));
+
+    if (ay > ax) r = FASTMATH_HALF_PI - r;
+    if (xSign) r = FASTMATH_PI - r;
+    return FastMathFlipSign(r, ySign);
+}
+
+// Batched versions over contiguous arrays
+void FastSinCosBatch(const float* angles, float* sines, float* cosines, size_t count);
+void FastAtan2Batch(const float* y, const float* x, float* angles, size_t count);
@@ -0,0 +1,135 @@
+// FastMathTest.cpp
+// Checks FastMath against libm and the batch versions against the scalar ones.
+// Standalone, it needs nothing from Windows:
+//   cl /O2 /EHsc FastMathTest.cpp FastMath.cpp
+//   g++ -O2 FastMathTest.cpp FastMath.cpp -o FastMathTest
+#include "FastMath.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Bounds documented in FastMath.h
+const float SINCOS_MAX_ERROR = 2e-7f;
+const float SINCOS_MAX_ANGLE = 1000.0f;
+const float ATAN2_MAX_ERROR = 2e-6f;
+
+static int failures = 0;
+
+static void Check(bool condition, const char* what, float a, float b)
+{
+    if (condition) return;
+    if (failures < 20) printf("FAIL %s (%.9g, %.9g)\n", what, a, b);
+    failures++;
+}
+
+static bool SameBits(float a, float b)
+{
+    uint32_t aBits, bBits;
+    memcpy(&aBits, &a, sizeof(aBits));
+    memcpy(&bBits, &b, sizeof(bBits));
+    return aBits == bBits;
+}
+
+static void TestSinCos()
+{
+    // Dense sweep over the stated range, plus the quadrant boundaries
+    std::vector<float> angles;
+    const int steps = 2000000;
+    for (int i = 0; i <= steps; i++) {
+        angles.push_back(-SINCOS_MAX_ANGLE + 2.0f * SINCOS_MAX_ANGLE * i / steps);
+    }
+    for (int k = -600; k <= 600; k++) {
+        float boundary = k * FASTMATH_HALF_PI;
+        angles.push_back(boundary);
+        angles.push_back(nextafterf(boundary, -INFINITY));
+        angles.push_back(nextafterf(boundary, INFINITY));
+    }
+    angles.push_back(0.0f);
+    angles.push_back(-0.0f);
+
+    float maxError = 0.0f;
+    for (float angle : angles) {
+        float sine, cosine;
+        FastSinCos(angle, sine, cosine);
+        float sineError = fabsf(sine - sinf(angle));
+        float cosineError = fabsf(cosine - cosf(angle));
+        Check(sineError < SINCOS_MAX_ERROR, "FastSinCos sine", angle, sine);
+        Check(cosineError < SINCOS_MAX_ERROR, "FastSinCos cosine", angle, cosine);
+        if (sineError > maxError) maxError = sineError;
+        if (cosineError > maxError) maxError = cosineError;
+    }
+
+    // Batch, including a tail that is not a multiple of four
+    size_t count = angles.size() - 3;
+    std::vector<float> sines(count), cosines(count);
+    FastSinCosBatch(angles.data(), sines.data(), cosines.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        float sine, cosine;
+        FastSinCos(angles[i], sine, cosine);
+        Check(SameBits(sines[i], sine), "FastSinCosBatch sine", angles[i], sines[i]);
+        Check(SameBits(cosines[i], cosine), "FastSinCosBatch cosine", angles[i], cosines[i]);
+    }
+
+    printf("FastSinCos: %zu angles, max error %.3g\n", angles.size(), maxError);
+}
+
+static void TestAtan2()
+{
+    // Points on circles of many radii, so every octant and both near-axis
+    // directions are covered, then the axes and signed zeros exactly
+    std::vector<float> ys, xs;
+    const float radii[] = { 1e-30f, 1e-6f, 0.5f, 1.0f, 3.0f, 1000.0f, 1e20f };
+    for (float radius : radii) {
+        const int steps = 100000;
+        for (int i = 0; i < steps; i++) {
+            double angle = -3.14159265358979 + 2.0 * 3.14159265358979 * i / steps;
+            ys.push_back((float)(radius * sin(angle)));
+            xs.push_back((float)(radius * cos(angle)));
+        }
+    }
+    const float axes[] = { 0.0f, -0.0f, 1.0f, -1.0f, 5.0f, -5.0f };
+    for (float y : axes) {
+        for (float x : axes) {
+            ys.push_back(y);
+            xs.push_back(x);
+        }
+    }
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < ys.size(); i++) {
+        float fast = FastAtan2(ys[i], xs[i]);
+        float exact = atan2f(ys[i], xs[i]);
+        float error = fabsf(fast - exact);
+        Check(error < ATAN2_MAX_ERROR, "FastAtan2", ys[i], xs[i]);
+        Check(std::signbit(fast) == std::signbit(exact), "FastAtan2 sign", ys[i], xs[i]);
+        if (error > maxError) maxError = error;
+    }
+
+    // The cases that used to differ from libm
+    Check(FastAtan2(-0.0f, -1.0f) < -3.14f, "FastAtan2(-0, -1) is -pi", -0.0f, -1.0f);
+    Check(FastAtan2(0.0f, -1.0f) > 3.14f, "FastAtan2(+0, -1) is +pi", 0.0f, -1.0f);
+    Check(FastAtan2(0.0f, -0.0f) > 3.14f, "FastAtan2(+0, -0) is +pi", 0.0f, -0.0f);
+    Check(SameBits(FastAtan2(-0.0f, 0.0f), -0.0f), "FastAtan2(-0, +0) is -0", -0.0f, 0.0f);
+
+    size_t count = ys.size() - 1;
+    std::vector<float> angles(count);
+    FastAtan2Batch(ys.data(), xs.data(), angles.data(), count);
+    for (size_t i = 0; i < count; i++) {
+        Check(SameBits(angles[i], FastAtan2(ys[i], xs[i])), "FastAtan2Batch", ys[i], xs[i]);
+    }
+
+    printf("FastAtan2: %zu points, max error %.3g\n", ys.size(), maxError);
+}
+
+int main()
+{
+    TestSinCos();
+    TestAtan2();
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
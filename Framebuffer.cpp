@@ -0,0 +1,263 @@
+#include "Framebuffer.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define FRAMEBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+static uint32_t ToByte(float value)
+{
+    if (value <= 0.0f) return 0;
+    if (value >= 1.0f) return 255;
+    return (uint32_t)(value * 255.0f + 0.5f);
+}
+
+Pixel PackPremultiplied(float r, float g, float b, float a)
+{
+    uint32_t alpha = ToByte(a);
+    uint32_t straight = (ToByte(r) << 16) | (ToByte(g) << 8) | ToByte(b);
+    return ScalePixel(straight | 0xFF000000, alpha);
+}
+
+#ifdef FRAMEBUFFER_SSE2
+// x * a / 255 on 16-bit lanes, rounded like ScalePixel
+static inline __m128i MulDiv255(__m128i x, __m128i a)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, a), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// Four pixels over dst: widen to 16 bits per channel, two pixels per half
+static inline __m128i Over4(__m128i src, __m128i dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    // 255 - alpha, repeated across the four channels of each pixel
+    __m128i inverse = _mm_sub_epi32(_mm_set1_epi32(255), _mm_srli_epi32(src, 24));
+    inverse = _mm_or_si128(inverse, _mm_slli_epi32(inverse, 16));
+    __m128i inverseLo = _mm_unpacklo_epi32(inverse, inverse);
+    __m128i inverseHi = _mm_unpackhi_epi32(inverse, inverse);
+
+    __m128i lo = MulDiv255(_mm_unpacklo_epi8(dst, zero), inverseLo);
+    __m128i hi = MulDiv255(_mm_unpackhi_epi8(dst, zero), inverseHi);
+    return _mm_add_epi8(src, _mm_packus_epi16(lo, hi));
+}
+#endif
+
+void BlendSpanOver(Pixel* dst, const Pixel* src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef FRAMEBUFFER_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), Over4(s, d));
+    }
+#endif
+
+    for (; i < count; i++) dst[i] = BlendOver(src[i], dst[i]);
+}
+
+void BlendSpanAdd(Pixel* dst, const Pixel* src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef FRAMEBUFFER_SSE2
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(s, d));
+    }
+#endif
+
+    for (; i < count; i++) dst[i] = BlendAdd(src[i], dst[i]);
+}
+
+void FillSpanOver(Pixel* dst, Pixel color, size_t count)
+{
+    // Opaque colors replace, transparent ones leave dst as is
+    if ((color >> 24) == 255) {
+        for (size_t i = 0; i < count; i++) dst[i] = color;
+        return;
+    }
+    if (color == 0) return;
+
+    size_t i = 0;
+
+#ifdef FRAMEBUFFER_SSE2
+    // The source and its inverse alpha are the same for every pixel, so only
+    // the destination is widened and scaled
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i s = _mm_set1_epi32((int)color);
+    const __m128i inverse = _mm_set1_epi16((short)(255 - (color >> 24)));
+
+    // Eight pixels per iteration keeps two independent chains in flight
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i d0 = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i d1 = _mm_loadu_si128((const __m128i*)(dst + i + 4));
+        __m128i r0 = _mm_packus_epi16(MulDiv255(_mm_unpacklo_epi8(d0, zero), inverse), MulDiv255(_mm_unpackhi_epi8(d0, zero), inverse));
+        __m128i r1 = _mm_packus_epi16(MulDiv255(_mm_unpacklo_epi8(d1, zero), inverse), MulDiv255(_mm_unpackhi_epi8(d1, zero), inverse));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(s, r0));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_add_epi8(s, r1));
+    }
+#endif
+
+    for (; i < count; i++) dst[i] = BlendOver(color, dst[i]);
+}
+
+void FillSpanAdd(Pixel* dst, Pixel color, size_t count)
+{
+    size_t i = 0;
+
+#ifdef FRAMEBUFFER_SSE2
+    const __m128i s = _mm_set1_epi32((int)color);
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_adds_epu8(s, d));
+    }
+#endif
+
+    for (; i < count; i++) dst[i] = BlendAdd(color, dst[i]);
+}
+
+Framebuffer::Framebuffer()
+{
+    width = 0;
+    height = 0;
+    brushColor = 0xFF000000; // Opaque black
+    blendMode = BLEND_OVER;
+    dirtyLeft = 0;
+    dirtyTop = 0;
+    dirtyRight = 0;
+    dirtyBottom = 0;
+}
+
+void Framebuffer::Resize(int w, int h)
+{
+    width = w > 0 ? w : 0;
+    height = h > 0 ? h : 0;
+    pixels.assign((size_t)width * height, 0);
+    dirtyLeft = dirtyTop = dirtyRight = dirtyBottom = 0;
+}
+
+void Framebuffer::Touch(int left, int top, int right, int bottom)
+{
+    if (dirtyLeft >= dirtyRight) {
+        dirtyLeft = left;
+        dirtyTop = top;
+        dirtyRight = right;
+        dirtyBottom = bottom;
+        return;
+    }
+    if (left < dirtyLeft) dirtyLeft = left;
+    if (top < dirtyTop) dirtyTop = top;
+    if (right > dirtyRight) dirtyRight = right;
+    if (bottom > dirtyBottom) dirtyBottom = bottom;
+}
+
+void Framebuffer::DrawPoint(int x, int y, uint32_t coverage)
+{
+    if (x < 0 || x >= width || y < 0 || y >= height) return;
+
+    Pixel color = coverage >= 255 ? brushColor : ScalePixel(brushColor, coverage);
+    Pixel& dst = pixels[(size_t)y * width + x];
+    dst = blendMode == BLEND_ADD ? BlendAdd(color, dst) : BlendOver(color, dst);
+    Touch(x, y, x + 1, y + 1);
+}
+
+void Framebuffer::DrawPoints(const int* x, const int* y, const Pixel* colors, size_t count)
+{
+    int left = width, top = height, right = 0, bottom = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int px = x[i];
+        int py = y[i];
+        if (px < 0 || px >= width || py < 0 || py >= height) continue;
+
+        Pixel& dst = pixels[(size_t)py * width + px];
+        dst = blendMode == BLEND_ADD ? BlendAdd(colors[i], dst) : BlendOver(colors[i], dst);
+
+        if (px < left) left = px;
+        if (py < top) top = py;
+        if (px >= right) right = px + 1;
+        if (py >= bottom) bottom = py + 1;
+    }
+
+    if (left < right) Touch(left, top, right, bottom);
+}
+
+void Framebuffer::DrawSquares(const int* x, const int* y, const Pixel* colors, size_t count, int size)
+{
+    if (size <= 1) {
+        DrawPoints(x, y, colors, count);
+        return;
+    }
+
+    int left = width, top = height, right = 0, bottom = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        int x0 = x[i] > 0 ? x[i] : 0;
+        int y0 = y[i] > 0 ? y[i] : 0;
+        int x1 = x[i] + size < width ? x[i] + size : width;
+        int y1 = y[i] + size < height ? y[i] + size : height;
+        if (x0 >= x1 || y0 >= y1) continue;
+
+        for (int row = y0; row < y1; row++) {
+            Pixel* dst = GetRow(row) + x0;
+            if (blendMode == BLEND_ADD) FillSpanAdd(dst, colors[i], x1 - x0);
+            else FillSpanOver(dst, colors[i], x1 - x0);
+        }
+
+        if (x0 < left) left = x0;
+        if (y0 < top) top = y0;
+        if (x1 > right) right = x1;
+        if (y1 > bottom) bottom = y1;
+    }
+
+    if (left < right) Touch(left, top, right, bottom);
+}
+
+void Framebuffer::FillSpan(int x, int y, int length)
+{
+    if (y < 0 || y >= height) return;
+    int end = x + length;
+    if (x < 0) x = 0;
+    if (end > width) end = width;
+    if (x >= end) return;
+
+    Pixel* row = GetRow(y) + x;
+    if (blendMode == BLEND_ADD) FillSpanAdd(row, brushColor, end - x);
+    else FillSpanOver(row, brushColor, end - x);
+    Touch(x, y, end, y + 1);
+}
+
+void Framebuffer::Fill(Pixel color)
+{
+    for (auto& pixel : pixels) pixel = color;
+    if (width > 0 && height > 0) Touch(0, 0, width, height);
+}
+
+bool Framebuffer::GetDirtyRect(int& left, int& top, int& right, int& bottom) const
+{
+    left = dirtyLeft;
+    top = dirtyTop;
+    right = dirtyRight;
+    bottom = dirtyBottom;
+    return dirtyLeft < dirtyRight;
+}
+
+void Framebuffer::ClearDirty()
+{
+    for (int y = dirtyTop; y < dirtyBottom && dirtyLeft < dirtyRight; y++) {
+        memset(GetRow(y) + dirtyLeft, 0, (size_t)(dirtyRight - dirtyLeft) * sizeof(Pixel));
+    }
+    dirtyLeft = dirtyTop = dirtyRight = dirtyBottom = 0;
+}
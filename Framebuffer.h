@@ -0,0 +1,113 @@
+// Framebuffer.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Premultiplied 8-bit BGRA, packed as 0xAARRGGBB so blue is the first byte in
+// memory, matching DXGI_FORMAT_B8G8R8A8_UNORM with D2D1_ALPHA_MODE_PREMULTIPLIED.
+typedef uint32_t Pixel;
+
+enum BlendMode {
+    BLEND_OVER, // dst = src + dst * (255 - srcAlpha) / 255
+    BLEND_ADD   // dst = min(src + dst, 255), for glows and sparks; Graphics keeps it
+                // additive when compositing the framebuffer onto the scene
+};
+
+// Straight-alpha float color to a premultiplied pixel
+Pixel PackPremultiplied(float r, float g, float b, float a);
+
+// Fixed-point blending, two channels per 32-bit multiply. x * a / 255 is
+// rounded exactly as (t + (t >> 8)) >> 8 with t = x * a + 128, which the SSE2
+// span kernels compute the same way, so both paths give identical pixels.
+inline Pixel ScalePixel(Pixel p, uint32_t coverage)
+{
+    uint32_t rb = (p & 0x00FF00FF) * coverage + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    uint32_t ag = ((p >> 8) & 0x00FF00FF) * coverage + 0x00800080;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// Premultiplied channels never exceed alpha, so the sum cannot carry
+inline Pixel BlendOver(Pixel src, Pixel dst)
+{
+    return src + ScalePixel(dst, 255 - (src >> 24));
+}
+
+inline Pixel BlendAdd(Pixel src, Pixel dst)
+{
+    uint32_t rb = (src & 0x00FF00FF) + (dst & 0x00FF00FF);
+    uint32_t ag = ((src >> 8) & 0x00FF00FF) + ((dst >> 8) & 0x00FF00FF);
+
+    // Channels that carried into bit 8 saturate to 255
+    rb = (rb | (((rb >> 8) & 0x00010001) * 0xFF)) & 0x00FF00FF;
+    ag = (ag | (((ag >> 8) & 0x00010001) * 0xFF)) & 0x00FF00FF;
+    return rb | (ag << 8);
+}
+
+// Span kernels over contiguous pixels, SSE2 four pixels at a time when available
+void BlendSpanOver(Pixel* dst, const Pixel* src, size_t count);
+void BlendSpanAdd(Pixel* dst, const Pixel* src, size_t count);
+void FillSpanOver(Pixel* dst, Pixel color, size_t count);
+void FillSpanAdd(Pixel* dst, Pixel color, size_t count);
+
+// CPU render target for effects Direct2D draws one call per pixel: blended
+// points, antialiased lines and particles. Tracks the rectangle touched since
+// the last ClearDirty so only that part has to be uploaded. The software
+// graphics backend draws whole frames into one.
+class Framebuffer
+{
+private:
+    int width;
+    int height;
+    std::vector<Pixel> pixels;
+    Pixel brushColor;
+    BlendMode blendMode;
+
+    // Touched region, empty when dirtyLeft >= dirtyRight
+    int dirtyLeft;
+    int dirtyTop;
+    int dirtyRight;
+    int dirtyBottom;
+
+    void Touch(int left, int top, int right, int bottom);
+
+public:
+    Framebuffer();
+
+    void Resize(int width, int height);
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    Pixel* GetRow(int y) { return &pixels[(size_t)y * width]; }
+    const Pixel* GetRow(int y) const { return &pixels[(size_t)y * width]; }
+    uint32_t GetPitch() const { return (uint32_t)width * sizeof(Pixel); }
+
+    void SetBrushColor(float r, float g, float b, float a) { brushColor = PackPremultiplied(r, g, b, a); }
+    void SetBrushColor(Pixel premultiplied) { brushColor = premultiplied; }
+    Pixel GetBrushColor() const { return brushColor; }
+    void SetBlendMode(BlendMode mode) { blendMode = mode; }
+
+    // Blend the brush into one pixel, scaled by coverage in [0, 255]
+    void DrawPoint(int x, int y, uint32_t coverage = 255);
+
+    // Blend one premultiplied color per point, skipping points outside the buffer
+    void DrawPoints(const int* x, const int* y, const Pixel* colors, size_t count);
+
+    // Blend size x size squares with their top-left corner at each point,
+    // one premultiplied color per square; the sprite path for particles
+    void DrawSquares(const int* x, const int* y, const Pixel* colors, size_t count, int size);
+
+    // Blend the brush over a horizontal run of pixels, clipped to the buffer
+    void FillSpan(int x, int y, int length);
+
+    // Replace every pixel, ignoring the blend mode
+    void Fill(Pixel color);
+
+    // Dirty region, in pixels; false when nothing was drawn
+    bool GetDirtyRect(int& left, int& top, int& right, int& bottom) const;
+
+    // Reset the touched region to transparent
+    void ClearDirty();
+};
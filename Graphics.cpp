@@ -1,5 +1,10 @@
 #include "Graphics.h"
 #include <iostream>
+#include <cfloat>
+#include <cstring>
+
+// The device context backend creates its Direct3D device itself
+#pragma comment(lib, "d3d11.lib")
 
 // Constants for Cohen-Sutherland Clipping
 const int INSIDE = 0; // 0000
@@ -8,31 +13,61 @@ const int RIGHT = 2;  // 0010
 const int BOTTOM = 4; // 0100
 const int TOP = 8;    // 1000
 
+// Premultiplied BGRA colors for terrain pixels
+const UINT32 TERRAIN_SOLID = 0xFF008000; // Green, matches DrawHill
+const UINT32 TERRAIN_EMPTY = 0x00000000;
+
+const D2D1_COLOR_F SKY_COLOR = { 0.529f, 0.808f, 0.922f, 1.0f }; // Light Blue
+
 Graphics::Graphics()
 {
 	factory = NULL;
+	hwndTarget = NULL;
 	renderTarget = NULL;
+	target = NULL;
 	brush = NULL;
+	brushColor = D2D1::ColorF(0.0f, 0.0f, 0.0f, 1.0f);
 	bitmap = NULL;
+	canvas = &framebuffer;
 	size = D2D1::SizeU(0, 0);
+	cameraX = 0.0f;
+	cameraY = 0.0f;
+	backend = GRAPHICS_BACKEND_HWND;
+	window = NULL;
+	d3dDevice = NULL;
+	d2dDevice = NULL;
+	deviceContext = NULL;
+	swapChain = NULL;
+	backBuffer = NULL;
+	dirtyOverflow = false;
+	previousDirtyOverflow = false;
+	fullPresent = true;
+	presentedCameraX = 0.0f;
+	presentedCameraY = 0.0f;
+	layerCommands = NULL;
+	recordingLayer = false;
+	layerValid = false;
+	layerWidth = 0;
+	layerHeight = 0;
+	layerColumns = 0;
+	layerRows = 0;
+	terrainColumns = 0;
+	terrainRows = 0;
 }
 
 Graphics::~Graphics()
 {
-	if (factory) factory->Release();
-	if (renderTarget) renderTarget->Release();
+	ReleaseStaticLayer();
+	ReleaseTerrain();
 	if (brush) brush->Release();
 	if (bitmap) bitmap->Release();
+	if (hwndTarget) hwndTarget->Release();
+	ReleaseDeviceContext();
+	if (factory) factory->Release();
 }
 
-bool Graphics::Init(HWND windowHandle)
+bool Graphics::Init(HWND windowHandle, GraphicsBackend requestedBackend)
 {
-	HRESULT result = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &factory);
-	if (FAILED(result)) {
-		std::cerr << "Failed to create D2D1 Factory." << std::endl;
-		return false;
-	}
-
 	RECT rect;
 	GetClientRect(windowHandle, &rect);
 	size = D2D1::SizeU(
@@ -40,17 +75,43 @@ bool Graphics::Init(HWND windowHandle)
 		rect.bottom - rect.top
 	);
 
-	result = factory->CreateHwndRenderTarget(
-		D2D1::RenderTargetProperties(),
-		D2D1::HwndRenderTargetProperties(
-			windowHandle,
-			size),
-		&renderTarget);
+	// The software backend needs no Direct2D at all
+	if (requestedBackend == GRAPHICS_BACKEND_SOFTWARE) {
+		window = windowHandle;
+		return InitSoftware(size.width, size.height);
+	}
+
+	HRESULT result = D2D1CreateFactory(D2D1_FACTORY_TYPE_SINGLE_THREADED, &factory);
 	if (FAILED(result)) {
-		std::cerr << "Failed to create HwndRenderTarget." << std::endl;
+		std::cerr << "Failed to create D2D1 Factory." << std::endl;
 		return false;
 	}
 
+	if (requestedBackend == GRAPHICS_BACKEND_DEVICE_CONTEXT) {
+		if (InitDeviceContext(windowHandle)) {
+			backend = GRAPHICS_BACKEND_DEVICE_CONTEXT;
+		}
+		else {
+			std::cerr << "Device context unavailable, using HwndRenderTarget." << std::endl;
+			ReleaseDeviceContext();
+		}
+	}
+
+	if (backend == GRAPHICS_BACKEND_HWND) {
+		result = factory->CreateHwndRenderTarget(
+			D2D1::RenderTargetProperties(),
+			D2D1::HwndRenderTargetProperties(
+				windowHandle,
+				size),
+			&hwndTarget);
+		if (FAILED(result)) {
+			std::cerr << "Failed to create HwndRenderTarget." << std::endl;
+			return false;
+		}
+		renderTarget = hwndTarget;
+	}
+	target = renderTarget;
+
 	// Create a default brush (black)
 	result = renderTarget->CreateSolidColorBrush(
 		D2D1::ColorF(
@@ -67,41 +128,608 @@ bool Graphics::Init(HWND windowHandle)
 	return true;
 }
 
+bool Graphics::InitSoftware(UINT width, UINT height)
+{
+	backend = GRAPHICS_BACKEND_SOFTWARE;
+	size = D2D1::SizeU(width, height);
+	framebuffer.Resize(width, height);
+	canvas = &framebuffer;
+	return true;
+}
+
+bool Graphics::InitDeviceContext(HWND windowHandle)
+{
+	// Direct2D 1.1 is missing on systems without the platform update
+	ID2D1Factory1* factory1 = nullptr;
+	if (FAILED(factory->QueryInterface(__uuidof(ID2D1Factory1), (void**)&factory1))) return false;
+
+	// BGRA support is required for Direct2D to draw into the swap chain
+	HRESULT hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+		nullptr, 0, D3D11_SDK_VERSION, &d3dDevice, nullptr, nullptr);
+	if (FAILED(hr)) {
+		hr = D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_WARP, nullptr, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+			nullptr, 0, D3D11_SDK_VERSION, &d3dDevice, nullptr, nullptr);
+	}
+
+	IDXGIDevice1* dxgiDevice = nullptr;
+	IDXGIAdapter* adapter = nullptr;
+	IDXGIFactory2* dxgiFactory = nullptr;
+	bool created = SUCCEEDED(hr)
+		&& SUCCEEDED(d3dDevice->QueryInterface(__uuidof(IDXGIDevice1), (void**)&dxgiDevice))
+		&& SUCCEEDED(factory1->CreateDevice(dxgiDevice, &d2dDevice))
+		&& SUCCEEDED(d2dDevice->CreateDeviceContext(D2D1_DEVICE_CONTEXT_OPTIONS_NONE, &deviceContext))
+		&& SUCCEEDED(dxgiDevice->GetAdapter(&adapter))
+		&& SUCCEEDED(adapter->GetParent(__uuidof(IDXGIFactory2), (void**)&dxgiFactory));
+
+	if (created) {
+		// Flip model: the compositor takes the back buffer instead of copying it
+		DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+		swapChainDesc.Width = size.width;
+		swapChainDesc.Height = size.height;
+		swapChainDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+		swapChainDesc.SampleDesc.Count = 1;
+		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+		swapChainDesc.BufferCount = 2;
+		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+		created = SUCCEEDED(dxgiFactory->CreateSwapChainForHwnd(d3dDevice, windowHandle, &swapChainDesc, nullptr, nullptr, &swapChain));
+	}
+
+	// Queue at most one frame ahead of the display to keep input latency down
+	if (created) dxgiDevice->SetMaximumFrameLatency(1);
+
+	if (dxgiFactory) dxgiFactory->Release();
+	if (adapter) adapter->Release();
+	if (dxgiDevice) dxgiDevice->Release();
+	factory1->Release();
+
+	if (!created || !CreateBackBuffer()) return false;
+	renderTarget = deviceContext;
+	return true;
+}
+
+bool Graphics::CreateBackBuffer()
+{
+	IDXGISurface* surface = nullptr;
+	HRESULT hr = swapChain->GetBuffer(0, __uuidof(IDXGISurface), (void**)&surface);
+	if (SUCCEEDED(hr)) {
+		D2D1_BITMAP_PROPERTIES1 bitmapProperties = D2D1::BitmapProperties1(
+			D2D1_BITMAP_OPTIONS_TARGET | D2D1_BITMAP_OPTIONS_CANNOT_DRAW,
+			D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE)
+		);
+		hr = deviceContext->CreateBitmapFromDxgiSurface(surface, &bitmapProperties, &backBuffer);
+		surface->Release();
+	}
+	if (FAILED(hr)) {
+		std::cerr << "Failed to create swap chain back buffer." << std::endl;
+		backBuffer = nullptr;
+		return false;
+	}
+
+	deviceContext->SetTarget(backBuffer);
+	fullPresent = true;
+	return true;
+}
+
+void Graphics::ReleaseDeviceContext()
+{
+	if (deviceContext) deviceContext->SetTarget(nullptr);
+	if (backBuffer) backBuffer->Release();
+	if (swapChain) swapChain->Release();
+	if (deviceContext) deviceContext->Release();
+	if (d2dDevice) d2dDevice->Release();
+	if (d3dDevice) d3dDevice->Release();
+	backBuffer = nullptr;
+	swapChain = nullptr;
+	deviceContext = nullptr;
+	d2dDevice = nullptr;
+	d3dDevice = nullptr;
+}
+
+void Graphics::Resize(UINT width, UINT height)
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		size = D2D1::SizeU(width, height);
+		framebuffer.Resize(width, height);
+		return;
+	}
+	if (!renderTarget) return;
+
+	size = D2D1::SizeU(width, height);
+
+	// The framebuffer bitmap follows the window size, recreate it on next use
+	if (bitmap) bitmap->Release();
+	bitmap = nullptr;
+
+	if (backend == GRAPHICS_BACKEND_DEVICE_CONTEXT) {
+		// Minimized windows keep their buffers
+		if (width == 0 || height == 0) return;
+
+		// Buffers can only be resized once nothing references them
+		deviceContext->SetTarget(nullptr);
+		if (backBuffer) backBuffer->Release();
+		backBuffer = nullptr;
+		if (FAILED(swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0))) {
+			std::cerr << "Failed to resize swap chain." << std::endl;
+			return;
+		}
+		// The command list does not depend on the target size, so it is kept
+		CreateBackBuffer();
+		return;
+	}
+
+	hwndTarget->Resize(size);
+
+	// The cached tiles were rasterized for the old target, rebuild them lazily
+	InvalidateStaticLayer();
+}
+
+void Graphics::BeginDraw()
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) return;
+
+	previousDirtyRects.swap(dirtyRects);
+	dirtyRects.clear();
+	previousDirtyOverflow = dirtyOverflow;
+	dirtyOverflow = false;
+
+	renderTarget->BeginDraw();
+}
+
+void Graphics::EndDraw()
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		PresentSoftware();
+		return;
+	}
+
+	HRESULT hr = renderTarget->EndDraw();
+	if (backend == GRAPHICS_BACKEND_DEVICE_CONTEXT && SUCCEEDED(hr)) Present();
+}
+
+// Record a changed region, given in world coordinates
+void Graphics::MarkDirty(float left, float top, float right, float bottom)
+{
+	if (backend != GRAPHICS_BACKEND_DEVICE_CONTEXT || dirtyOverflow || recordingLayer) return;
+	if (dirtyRects.size() >= MAX_DIRTY_RECTS) {
+		dirtyOverflow = true;
+		return;
+	}
+
+	// Round outwards to window pixels and clip, DXGI rejects rects outside the buffer
+	RECT rect;
+	rect.left = (LONG)floorf(left - cameraX);
+	rect.top = (LONG)floorf(top - cameraY);
+	rect.right = (LONG)ceilf(right - cameraX);
+	rect.bottom = (LONG)ceilf(bottom - cameraY);
+	if (rect.left < 0) rect.left = 0;
+	if (rect.top < 0) rect.top = 0;
+	if (rect.right > (LONG)size.width) rect.right = (LONG)size.width;
+	if (rect.bottom > (LONG)size.height) rect.bottom = (LONG)size.height;
+	if (rect.left < rect.right && rect.top < rect.bottom) dirtyRects.push_back(rect);
+}
+
+void Graphics::Present()
+{
+	// A moving camera shifts every pixel, so only a still one can present rects.
+	// Objects are redrawn where they are now and uncovered where they were last frame.
+	bool whole = fullPresent || dirtyOverflow || previousDirtyOverflow ||
+		cameraX != presentedCameraX || cameraY != presentedCameraY;
+
+	DXGI_PRESENT_PARAMETERS parameters = {};
+	if (!whole) {
+		presentRects.assign(dirtyRects.begin(), dirtyRects.end());
+		presentRects.insert(presentRects.end(), previousDirtyRects.begin(), previousDirtyRects.end());
+		parameters.DirtyRectsCount = (UINT)presentRects.size();
+		parameters.pDirtyRects = presentRects.data();
+	}
+
+	HRESULT hr = swapChain->Present1(1, 0, &parameters);
+	if (FAILED(hr)) {
+		std::cerr << "Failed to present swap chain." << std::endl;
+	}
+	fullPresent = false;
+	presentedCameraX = cameraX;
+	presentedCameraY = cameraY;
+}
+
+// Copy the frame to the window through GDI; headless frames stay in the framebuffer
+void Graphics::PresentSoftware()
+{
+	if (!window || framebuffer.GetWidth() == 0 || framebuffer.GetHeight() == 0) return;
+
+	// Top-down 32-bit DIB, which has the framebuffer's BGRA byte order
+	BITMAPINFO info = {};
+	info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+	info.bmiHeader.biWidth = framebuffer.GetWidth();
+	info.bmiHeader.biHeight = -framebuffer.GetHeight();
+	info.bmiHeader.biPlanes = 1;
+	info.bmiHeader.biBitCount = 32;
+	info.bmiHeader.biCompression = BI_RGB;
+
+	HDC dc = GetDC(window);
+	if (!dc) return;
+	SetDIBitsToDevice(dc, 0, 0, framebuffer.GetWidth(), framebuffer.GetHeight(),
+		0, 0, 0, framebuffer.GetHeight(), framebuffer.GetRow(0), &info, DIB_RGB_COLORS);
+	ReleaseDC(window, dc);
+}
+
 D2D1_COLOR_F Graphics::GetBrushColor()
 {
-	return brush->GetColor();
+	return brushColor;
 }
 
 void Graphics::SetBrushColor(D2D1_COLOR_F color)
 {
-	brush->SetColor(color);
+	brushColor = color;
+	if (brush) brush->SetColor(color);
 }
 
 void Graphics::SetBrushColor(float r, float g, float b, float a)
 {
-	brush->SetColor(D2D1::ColorF(r, g, b, a));
+	SetBrushColor(D2D1::ColorF(r, g, b, a));
+}
+
+Pixel Graphics::GetBrushPixel()
+{
+	return PackPremultiplied(brushColor.r, brushColor.g, brushColor.b, brushColor.a);
+}
+
+void Graphics::FillRectSoftware(float left, float top, float right, float bottom)
+{
+	int x0 = (int)ceilf(left - cameraX - 0.5f);
+	int x1 = (int)ceilf(right - cameraX - 0.5f);
+	int y0 = max((int)ceilf(top - cameraY - 0.5f), 0);
+	int y1 = min((int)ceilf(bottom - cameraY - 0.5f), canvas->GetHeight());
+
+	canvas->SetBrushColor(GetBrushPixel());
+	for (int y = y0; y < y1; y++) canvas->FillSpan(x0, y, x1 - x0);
+}
+
+void Graphics::FillCircleSoftware(float centerX, float centerY, float radius)
+{
+	int y0 = max((int)ceilf(centerY - radius - cameraY - 0.5f), 0);
+	int y1 = min((int)floorf(centerY + radius - cameraY - 0.5f), canvas->GetHeight() - 1);
+
+	canvas->SetBrushColor(GetBrushPixel());
+	for (int y = y0; y <= y1; y++)
+	{
+		float dy = cameraY + y + 0.5f - centerY;
+		float halfSq = radius * radius - dy * dy;
+		if (halfSq < 0.0f) continue;
+
+		float half = sqrtf(halfSq);
+		int x0 = (int)ceilf(centerX - half - cameraX - 0.5f);
+		int x1 = (int)floorf(centerX + half - cameraX - 0.5f);
+		canvas->FillSpan(x0, y, x1 - x0 + 1);
+	}
+}
+
+// Scanline fill; each row of a convex polygon is a single span between its edges
+void Graphics::FillConvexSoftware(const D2D1_POINT_2F* points, int count)
+{
+	float top = points[0].y, bottom = points[0].y;
+	for (int i = 1; i < count; i++) {
+		top = min(top, points[i].y);
+		bottom = max(bottom, points[i].y);
+	}
+	int y0 = max((int)ceilf(top - cameraY - 0.5f), 0);
+	int y1 = min((int)ceilf(bottom - cameraY - 0.5f), canvas->GetHeight());
+
+	canvas->SetBrushColor(GetBrushPixel());
+	for (int y = y0; y < y1; y++)
+	{
+		float centerY = cameraY + y + 0.5f;
+		float left = FLT_MAX, right = -FLT_MAX;
+		for (int i = 0; i < count; i++)
+		{
+			const D2D1_POINT_2F& a = points[i];
+			const D2D1_POINT_2F& b = points[(i + 1) % count];
+			if ((a.y <= centerY) == (b.y <= centerY)) continue;
+
+			float x = a.x + (centerY - a.y) * (b.x - a.x) / (b.y - a.y);
+			left = min(left, x);
+			right = max(right, x);
+		}
+		if (left > right) continue;
+
+		int x0 = (int)ceilf(left - cameraX - 0.5f);
+		int x1 = (int)floorf(right - cameraX - 0.5f);
+		canvas->FillSpan(x0, y, x1 - x0 + 1);
+	}
 }
 
 void Graphics::ClearScreen()
 {
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		canvas->Fill(PackPremultiplied(SKY_COLOR.r, SKY_COLOR.g, SKY_COLOR.b, 1.0f));
+		return;
+	}
+
+	fullPresent = true;
 	// Clear with a sky-blue color
-	renderTarget->Clear(D2D1::ColorF(0.529f, 0.808f, 0.922f)); // Light Blue
+	target->Clear(SKY_COLOR);
 }
 
 void Graphics::DrawPoint(float x, float y)
 {
-	renderTarget->DrawEllipse(D2D1::Ellipse(D2D1::Point2F(x, y), 0.5f, 0.5f), brush, 1.0f);
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		canvas->SetBrushColor(GetBrushPixel());
+		canvas->DrawPoint((int)floorf(x - cameraX), (int)floorf(y - cameraY));
+		return;
+	}
+
+	MarkDirty(x - 1.0f, y - 1.0f, x + 1.0f, y + 1.0f);
+	target->DrawEllipse(D2D1::Ellipse(D2D1::Point2F(x, y), 0.5f, 0.5f), brush, 1.0f);
 }
 
 void Graphics::DrawPoints(std::vector<std::pair<float, float>> points, std::vector<D2D1::ColorF> intensity)
 {
-	D2D1_COLOR_F oldBrushColor = GetBrushColor();
-	for (size_t it = 0; it < points.size(); it++)
+	// Cached layers are drawn in their own coordinates, so they keep one Direct2D call per point
+	if (!CanUseFramebuffer()) {
+		D2D1_COLOR_F oldBrushColor = GetBrushColor();
+		for (size_t it = 0; it < points.size(); it++)
+		{
+			SetBrushColor(intensity[it]);
+			DrawPoint(points[it].first, points[it].second);
+		}
+		SetBrushColor(oldBrushColor);
+		return;
+	}
+
+	// Blend every point on the CPU in window pixels, then upload the touched rectangle once
+	size_t count = points.size();
+	pointX.resize(count);
+	pointY.resize(count);
+	pointColors.resize(count);
+	for (size_t it = 0; it < count; it++)
 	{
-		SetBrushColor(intensity[it]);
-		DrawPoint(points[it].first, points[it].second);
+		pointX[it] = (int)floorf(points[it].first - cameraX);
+		pointY[it] = (int)floorf(points[it].second - cameraY);
+		pointColors[it] = PackPremultiplied(intensity[it].r, intensity[it].g, intensity[it].b, intensity[it].a);
+	}
+	canvas->DrawPoints(pointX.data(), pointY.data(), pointColors.data(), count);
+	FlushFramebuffer();
+}
+
+// The framebuffer covers the window, so it is only used when drawing straight to it.
+// The software backend always draws into its canvas.
+bool Graphics::CanUseFramebuffer()
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) return true;
+	if (target != renderTarget || recordingLayer) return false;
+	if (!bitmap) CreateBitmap();
+	return bitmap != nullptr;
+}
+
+void Graphics::FlushFramebuffer(BlendMode mode)
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) return; // Already part of the frame
+
+	int left, top, right, bottom;
+	if (!framebuffer.GetDirtyRect(left, top, right, bottom)) return;
+
+	// Premultiplied source-over with a zero source alpha is dst + src, so clearing
+	// the alpha makes Direct2D add an additive batch to the scene below it
+	if (mode == BLEND_ADD) {
+		for (int y = top; y < bottom; y++)
+		{
+			Pixel* row = framebuffer.GetRow(y);
+			for (int x = left; x < right; x++) row[x] &= 0x00FFFFFF;
+		}
+	}
+
+	D2D1_RECT_U rect = D2D1::RectU(left, top, right, bottom);
+	bitmap->CopyFromMemory(&rect, framebuffer.GetRow(top) + left, framebuffer.GetPitch());
+
+	// Window pixels map 1:1 onto the viewport under the camera transform
+	D2D1_RECT_F source = D2D1::RectF((float)left, (float)top, (float)right, (float)bottom);
+	D2D1_RECT_F destination = D2D1::RectF(cameraX + left, cameraY + top, cameraX + right, cameraY + bottom);
+	target->DrawBitmap(bitmap, destination, 1.0f, D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR, &source);
+	MarkDirty(destination.left, destination.top, destination.right, destination.bottom);
+
+	// Leave the framebuffer transparent for the next batch
+	framebuffer.ClearDirty();
+}
+
+void Graphics::SetCamera(float x, float y)
+{
+	// Snap to whole pixels so cached tiles are not resampled
+	cameraX = floorf(x + 0.5f);
+	cameraY = floorf(y + 0.5f);
+	if (renderTarget) renderTarget->SetTransform(D2D1::Matrix3x2F::Translation(-cameraX, -cameraY));
+}
+
+D2D1_RECT_F Graphics::GetViewport()
+{
+	D2D1_SIZE_F viewSize = renderTarget ? renderTarget->GetSize() : D2D1::SizeF((float)size.width, (float)size.height);
+	return D2D1::RectF(cameraX, cameraY, cameraX + viewSize.width, cameraY + viewSize.height);
+}
+
+void Graphics::SetStaticLayerSize(UINT width, UINT height)
+{
+	ReleaseStaticLayer();
+
+	layerWidth = width;
+	layerHeight = height;
+	layerColumns = (width + LAYER_TILE_SIZE - 1) / LAYER_TILE_SIZE;
+	layerRows = (height + LAYER_TILE_SIZE - 1) / LAYER_TILE_SIZE;
+	layerTiles.assign(layerColumns * layerRows, nullptr);
+}
+
+void Graphics::InvalidateStaticLayer()
+{
+	for (auto& tile : layerTiles) {
+		if (tile) tile->Release();
+		tile = nullptr;
+	}
+	if (layerCommands) layerCommands->Release();
+	layerCommands = nullptr;
+	layerValid = false;
+	fullPresent = true;
+}
+
+void Graphics::ReleaseStaticLayer()
+{
+	InvalidateStaticLayer();
+	layerTiles.clear();
+	layerPixels.Resize(0, 0);
+	layerWidth = 0;
+	layerHeight = 0;
+	layerColumns = 0;
+	layerRows = 0;
+}
+
+void Graphics::GetVisibleTiles(UINT columns, UINT rows, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow)
+{
+	D2D1_RECT_F view = GetViewport();
+	firstColumn = (int)floorf(view.left / LAYER_TILE_SIZE);
+	firstRow = (int)floorf(view.top / LAYER_TILE_SIZE);
+	lastColumn = (int)floorf(view.right / LAYER_TILE_SIZE);
+	lastRow = (int)floorf(view.bottom / LAYER_TILE_SIZE);
+	if (firstColumn < 0) firstColumn = 0;
+	if (firstRow < 0) firstRow = 0;
+	if (lastColumn >= (int)columns) lastColumn = (int)columns - 1;
+	if (lastRow >= (int)rows) lastRow = (int)rows - 1;
+}
+
+void Graphics::DrawStaticLayer(StaticLayerDrawFn drawLayer)
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		DrawStaticLayerSoftware(drawLayer);
+		return;
+	}
+
+	// The layer only covers the world; a window larger than the world would
+	// otherwise keep stale pixels past its edge
+	D2D1_RECT_F view = GetViewport();
+	if (view.left < 0.0f || view.top < 0.0f || view.right > layerWidth || view.bottom > layerHeight) {
+		renderTarget->Clear(SKY_COLOR);
+	}
+
+	if (backend == GRAPHICS_BACKEND_DEVICE_CONTEXT) {
+		DrawStaticLayerCommands(drawLayer);
+		return;
+	}
+
+	// Only visit the tiles that intersect the viewport
+	int firstColumn, firstRow, lastColumn, lastRow;
+	GetVisibleTiles(layerColumns, layerRows, firstColumn, firstRow, lastColumn, lastRow);
+
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		for (int column = firstColumn; column <= lastColumn; column++)
+		{
+			ID2D1BitmapRenderTarget*& tile = layerTiles[row * layerColumns + column];
+			float tileX = (float)(column * LAYER_TILE_SIZE);
+			float tileY = (float)(row * LAYER_TILE_SIZE);
+
+			if (!tile) {
+				// Rasterize the layer into the tile once, it stays valid until invalidated
+				HRESULT hr = renderTarget->CreateCompatibleRenderTarget(D2D1::SizeF(LAYER_TILE_SIZE, LAYER_TILE_SIZE), &tile);
+				if (FAILED(hr) || tile == nullptr) {
+					std::cerr << "Failed to create layer tile." << std::endl;
+					tile = nullptr;
+					continue;
+				}
+
+				target = tile;
+				tile->BeginDraw();
+				tile->SetTransform(D2D1::Matrix3x2F::Translation(-tileX, -tileY));
+				drawLayer(this);
+				tile->EndDraw();
+				target = renderTarget;
+			}
+
+			ID2D1Bitmap* tileBitmap = nullptr;
+			if (FAILED(tile->GetBitmap(&tileBitmap)) || tileBitmap == nullptr) continue;
+			renderTarget->DrawBitmap(
+				tileBitmap,
+				D2D1::RectF(tileX, tileY, tileX + LAYER_TILE_SIZE, tileY + LAYER_TILE_SIZE),
+				1.0f,
+				D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+			tileBitmap->Release();
+		}
+	}
+}
+
+// Device context backend: the layer is recorded into a command list once and
+// replayed every frame, clipped to the viewport. Unlike the tiles the list does
+// not depend on the target size, so resizing the window keeps it.
+void Graphics::DrawStaticLayerCommands(StaticLayerDrawFn drawLayer)
+{
+	if (!layerCommands) {
+		HRESULT hr = deviceContext->CreateCommandList(&layerCommands);
+		if (FAILED(hr) || layerCommands == nullptr) {
+			std::cerr << "Failed to create layer command list." << std::endl;
+			layerCommands = nullptr;
+			return;
+		}
+
+		// Record in world coordinates, then go back to the swap chain and camera
+		ID2D1Image* windowTarget = nullptr;
+		D2D1_MATRIX_3X2_F transform;
+		deviceContext->GetTarget(&windowTarget);
+		deviceContext->GetTransform(&transform);
+		deviceContext->SetTarget(layerCommands);
+		deviceContext->SetTransform(D2D1::Matrix3x2F::Identity());
+		recordingLayer = true;
+		drawLayer(this);
+		recordingLayer = false;
+		layerCommands->Close();
+		deviceContext->SetTarget(windowTarget);
+		deviceContext->SetTransform(transform);
+		if (windowTarget) windowTarget->Release();
+	}
+
+	// The recorded clear has no bounds, limit it to the visible part of the layer
+	D2D1_RECT_F view = GetViewport();
+	D2D1_RECT_F clip = D2D1::RectF(
+		view.left > 0.0f ? view.left : 0.0f,
+		view.top > 0.0f ? view.top : 0.0f,
+		view.right < layerWidth ? view.right : (float)layerWidth,
+		view.bottom < layerHeight ? view.bottom : (float)layerHeight);
+	deviceContext->PushAxisAlignedClip(clip, D2D1_ANTIALIAS_MODE_ALIASED);
+	deviceContext->DrawImage(layerCommands);
+	deviceContext->PopAxisAlignedClip();
+}
+
+// Software backend: the layer is rasterized once for the whole world, like
+// the tiles, and the visible part is copied into the frame row by row
+void Graphics::DrawStaticLayerSoftware(StaticLayerDrawFn drawLayer)
+{
+	if (!layerValid) {
+		float savedCameraX = cameraX;
+		float savedCameraY = cameraY;
+		cameraX = 0.0f;
+		cameraY = 0.0f;
+		layerPixels.Resize(layerWidth, layerHeight);
+		canvas = &layerPixels;
+		recordingLayer = true;
+		drawLayer(this);
+		recordingLayer = false;
+		canvas = &framebuffer;
+		cameraX = savedCameraX;
+		cameraY = savedCameraY;
+		layerValid = true;
+	}
+
+	// Camera positions are whole pixels, see SetCamera
+	int left = (int)cameraX;
+	int top = (int)cameraY;
+	int width = framebuffer.GetWidth();
+	int height = framebuffer.GetHeight();
+	if (left < 0 || top < 0 || left + width > (int)layerWidth || top + height > (int)layerHeight) {
+		framebuffer.Fill(PackPremultiplied(SKY_COLOR.r, SKY_COLOR.g, SKY_COLOR.b, 1.0f));
+	}
+
+	int x0 = max(left, 0);
+	int x1 = min(left + width, (int)layerWidth);
+	int y0 = max(top, 0);
+	int y1 = min(top + height, (int)layerHeight);
+	for (int y = y0; y < y1 && x0 < x1; y++)
+	{
+		memcpy(framebuffer.GetRow(y - top) + (x0 - left), layerPixels.GetRow(y) + x0, (size_t)(x1 - x0) * sizeof(Pixel));
 	}
-	SetBrushColor(oldBrushColor);
 }
 
 void Graphics::DrawHill(float centerX, float centerY, float radius)
@@ -111,7 +739,7 @@ void Graphics::DrawHill(float centerX, float centerY, float radius)
 
 	// Create a green brush for hills
 	ID2D1SolidColorBrush* hillBrush = nullptr;
-	HRESULT hr = renderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Green), &hillBrush);
+	HRESULT hr = target->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Green), &hillBrush);
 	if (FAILED(hr) || hillBrush == nullptr) {
 		std::cerr << "Failed to create hillBrush." << std::endl;
 		return;
@@ -120,15 +748,185 @@ void Graphics::DrawHill(float centerX, float centerY, float radius)
 	// Fill the lower semi-circle to represent the hill
 	// Clip the drawing to the lower half
 	D2D1_RECT_F clipRect = D2D1::RectF(centerX - radius, centerY, centerX + radius, centerY + radius);
-	renderTarget->PushAxisAlignedClip(clipRect, D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
-	renderTarget->FillEllipse(ellipse, hillBrush);
-	renderTarget->PopAxisAlignedClip();
+	target->PushAxisAlignedClip(clipRect, D2D1_ANTIALIAS_MODE_PER_PRIMITIVE);
+	target->FillEllipse(ellipse, hillBrush);
+	target->PopAxisAlignedClip();
 
 	// Release the hill brush
 	hillBrush->Release();
 }
 
+void Graphics::ReleaseTerrain()
+{
+	for (auto& tile : terrainTiles) {
+		if (tile) tile->Release();
+	}
+	terrainTiles.clear();
+	terrainColumns = 0;
+	terrainRows = 0;
+}
+
+void Graphics::UploadTerrainRows(const Terrain& terrain, int firstRow, int lastRow)
+{
+	// All rows lie in the same band of tiles
+	int tileRow = firstRow / LAYER_TILE_SIZE;
+	int tileY = tileRow * LAYER_TILE_SIZE;
+	int rowCount = lastRow - firstRow + 1;
+
+	for (UINT column = 0; column < terrainColumns; column++)
+	{
+		ID2D1Bitmap* tile = terrainTiles[tileRow * terrainColumns + column];
+		if (!tile) continue;
+
+		// Tiles start on a word boundary since LAYER_TILE_SIZE is a multiple of 64
+		int tileX = column * LAYER_TILE_SIZE;
+		int tileWidth = min(LAYER_TILE_SIZE, terrain.GetWidth() - tileX);
+		terrainPixels.resize((size_t)tileWidth * rowCount);
+
+		for (int y = firstRow; y <= lastRow; y++)
+		{
+			const uint64_t* row = terrain.GetRow(y) + tileX / 64;
+			UINT32* out = &terrainPixels[(size_t)(y - firstRow) * tileWidth];
+
+			for (int x = 0; x < tileWidth; x += 64)
+			{
+				uint64_t word = row[x / 64];
+				int count = min(64, tileWidth - x);
+
+				// Whole words of sky or ground are filled without testing each bit
+				if (word == 0) {
+					for (int b = 0; b < count; b++) out[x + b] = TERRAIN_EMPTY;
+				}
+				else if (word == ~0ULL) {
+					for (int b = 0; b < count; b++) out[x + b] = TERRAIN_SOLID;
+				}
+				else {
+					for (int b = 0; b < count; b++) out[x + b] = ((word >> b) & 1) ? TERRAIN_SOLID : TERRAIN_EMPTY;
+				}
+			}
+		}
+
+		D2D1_RECT_U rect = D2D1::RectU(0, firstRow - tileY, tileWidth, lastRow - tileY + 1);
+		tile->CopyFromMemory(&rect, terrainPixels.data(), tileWidth * sizeof(UINT32));
+	}
+}
+
+// Software backend: solid terrain pixels are written straight into the frame,
+// whole words of sky or ground at a time like UploadTerrainRows
+void Graphics::DrawTerrainSoftware(const Terrain& terrain)
+{
+	int left = (int)cameraX;
+	int top = (int)cameraY;
+	int x0 = max(left, 0);
+	int x1 = min(left + canvas->GetWidth(), terrain.GetWidth());
+	int y0 = max(top, 0);
+	int y1 = min(top + canvas->GetHeight(), terrain.GetHeight());
+
+	for (int y = y0; y < y1; y++)
+	{
+		const uint64_t* row = terrain.GetRow(y);
+		Pixel* out = canvas->GetRow(y - top) - left;
+
+		for (int x = x0; x < x1; )
+		{
+			uint64_t word = row[x / 64];
+			int end = min((x / 64 + 1) * 64, x1);
+
+			if (word == ~0ULL) {
+				for (; x < end; x++) out[x] = TERRAIN_SOLID;
+			}
+			else if (word != 0) {
+				for (; x < end; x++) {
+					if ((word >> (x & 63)) & 1) out[x] = TERRAIN_SOLID;
+				}
+			}
+			x = end;
+		}
+	}
+}
+
+void Graphics::DrawTerrain(Terrain& terrain)
+{
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		DrawTerrainSoftware(terrain);
+		terrain.ClearDirtyRows();
+		return;
+	}
+
+	UINT columns = (terrain.GetWidth() + LAYER_TILE_SIZE - 1) / LAYER_TILE_SIZE;
+	UINT rows = (terrain.GetHeight() + LAYER_TILE_SIZE - 1) / LAYER_TILE_SIZE;
+
+	// (Re)create the tile bitmaps when the terrain size changes
+	if (columns != terrainColumns || rows != terrainRows) {
+		ReleaseTerrain();
+		terrainColumns = columns;
+		terrainRows = rows;
+		terrainTiles.assign(columns * rows, nullptr);
+
+		D2D1_BITMAP_PROPERTIES bitmapProperties = D2D1::BitmapProperties(
+			D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)
+		);
+		for (UINT row = 0; row < rows; row++)
+		{
+			for (UINT column = 0; column < columns; column++)
+			{
+				D2D1_SIZE_U tileSize = D2D1::SizeU(
+					min(LAYER_TILE_SIZE, terrain.GetWidth() - (int)column * LAYER_TILE_SIZE),
+					min(LAYER_TILE_SIZE, terrain.GetHeight() - (int)row * LAYER_TILE_SIZE));
+				HRESULT hr = target->CreateBitmap(tileSize, nullptr, 0, bitmapProperties, &terrainTiles[row * columns + column]);
+				if (FAILED(hr)) {
+					std::cerr << "Failed to create terrain tile." << std::endl;
+					terrainTiles[row * columns + column] = nullptr;
+				}
+			}
+		}
+		terrain.MarkAllDirty();
+	}
+
+	// Re-rasterize only the runs of rows that changed, split at tile bands
+	int y = terrain.NextDirtyRow(0);
+	while (y >= 0)
+	{
+		int bandEnd = min((y / LAYER_TILE_SIZE + 1) * LAYER_TILE_SIZE, terrain.GetHeight()) - 1;
+		int last = y;
+		while (last < bandEnd && terrain.NextDirtyRow(last + 1) == last + 1) last++;
+
+		UploadTerrainRows(terrain, y, last);
+		MarkDirty(0.0f, (float)y, (float)terrain.GetWidth(), (float)(last + 1));
+		y = terrain.NextDirtyRow(last + 1);
+	}
+	terrain.ClearDirtyRows();
+
+	// Draw the tiles that intersect the viewport
+	int firstColumn, firstRow, lastColumn, lastRow;
+	GetVisibleTiles(terrainColumns, terrainRows, firstColumn, firstRow, lastColumn, lastRow);
+
+	for (int row = firstRow; row <= lastRow; row++)
+	{
+		for (int column = firstColumn; column <= lastColumn; column++)
+		{
+			ID2D1Bitmap* tile = terrainTiles[row * terrainColumns + column];
+			if (!tile) continue;
+
+			D2D1_SIZE_F tileSize = tile->GetSize();
+			float tileX = (float)(column * LAYER_TILE_SIZE);
+			float tileY = (float)(row * LAYER_TILE_SIZE);
+			target->DrawBitmap(
+				tile,
+				D2D1::RectF(tileX, tileY, tileX + tileSize.width, tileY + tileSize.height),
+				1.0f,
+				D2D1_BITMAP_INTERPOLATION_MODE_NEAREST_NEIGHBOR);
+		}
+	}
+}
+
 void Graphics::DrawCannon(const Cannon& cannon)
+{
+	DrawCannonBase(cannon);
+	DrawCannonBarrel(cannon);
+}
+
+void Graphics::DrawCannonBase(const Cannon& cannon)
 {
 	// Draw the base of the cannon
 	float baseWidth = 20.0f;
@@ -142,19 +940,32 @@ void Graphics::DrawCannon(const Cannon& cannon)
 
 	// Set brush color to dark gray for the cannon base
 	SetBrushColor(0.2f, 0.2f, 0.2f, 1.0f);
-	renderTarget->FillRectangle(baseRect, brush);
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		FillRectSoftware(baseRect.left, baseRect.top, baseRect.right, baseRect.bottom);
+		return;
+	}
+	target->FillRectangle(baseRect, brush);
+}
+
+void Graphics::DrawCannonBarrel(const Cannon& cannon)
+{
+	// Set brush color to dark gray for the cannon barrel
+	SetBrushColor(0.2f, 0.2f, 0.2f, 1.0f);
 
 	// Draw the barrel
 	float barrelLength = 30.0f;
 	float barrelWidth = 5.0f;
 
-	// Calculate the end point of the barrel based on the angle
-	float endX = cannon.x + barrelLength * cos(cannon.angle);
-	float endY = cannon.y + barrelLength * sin(cannon.angle);
+	// Calculate the end point of the barrel along the firing direction
+	float endX = cannon.x + barrelLength * cannon.dirX;
+	float endY = cannon.y + barrelLength * cannon.dirY;
 
 	// Calculate perpendicular vectors for the barrel width
-	float perpX = barrelWidth * sin(cannon.angle);
-	float perpY = -barrelWidth * cos(cannon.angle);
+	float perpX = barrelWidth * cannon.dirY;
+	float perpY = -barrelWidth * cannon.dirX;
+
+	float reach = barrelLength + barrelWidth + 1.0f;
+	MarkDirty(cannon.x - reach, cannon.y - reach, cannon.x + reach, cannon.y + reach);
 
 	// Define the six corners of the barrel polygon
 	D2D1_POINT_2F barrelPoints[6] = {
@@ -166,6 +977,11 @@ void Graphics::DrawCannon(const Cannon& cannon)
 		D2D1::Point2F(cannon.x - perpX, cannon.y - perpY)
 	};
 
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		FillConvexSoftware(barrelPoints, 6);
+		return;
+	}
+
 	// Create a path geometry for the barrel
 	ID2D1PathGeometry* pathGeometry = nullptr;
 	HRESULT hr = factory->CreatePathGeometry(&pathGeometry);
@@ -192,7 +1008,7 @@ void Graphics::DrawCannon(const Cannon& cannon)
 	geometrySink->Close();
 
 	// Fill the barrel geometry
-	renderTarget->FillGeometry(pathGeometry, brush);
+	target->FillGeometry(pathGeometry, brush);
 
 	// Release resources
 	geometrySink->Release();
@@ -204,19 +1020,85 @@ void Graphics::DrawCannonball(const Cannonball& cannonball)
 	// Set brush color to black for cannonballs
 	SetBrushColor(D2D1::ColorF(D2D1::ColorF::Black));
 
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		FillCircleSoftware(cannonball.x, cannonball.y, 5.0f);
+		return;
+	}
+
 	D2D1_ELLIPSE ellipse = D2D1::Ellipse(D2D1::Point2F(cannonball.x, cannonball.y), 5.0f, 5.0f);
-	renderTarget->FillEllipse(ellipse, brush);
+	target->FillEllipse(ellipse, brush);
+	MarkDirty(cannonball.x - 6.0f, cannonball.y - 6.0f, cannonball.x + 6.0f, cannonball.y + 6.0f);
 }
 
 void Graphics::DrawCharacter(float x, float y, float radius)
 {
 	// Set brush color to blue for the character
 	SetBrushColor(D2D1::ColorF(D2D1::ColorF::Blue));
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		FillCircleSoftware(x, y, radius);
+		return;
+	}
 
 	D2D1_ELLIPSE ellipse = D2D1::Ellipse(D2D1::Point2F(x, y), radius, radius);
-	renderTarget->FillEllipse(ellipse, brush);
+	target->FillEllipse(ellipse, brush);
+	MarkDirty(x - radius - 1.0f, y - radius - 1.0f, x + radius + 1.0f, y + radius + 1.0f);
 }
 
+void Graphics::DrawSurvivor(float x, float y, float radius)
+{
+	// Set brush color to orange for AI survivors
+	SetBrushColor(D2D1::ColorF(D2D1::ColorF::Orange));
+	if (backend == GRAPHICS_BACKEND_SOFTWARE) {
+		FillCircleSoftware(x, y, radius);
+		return;
+	}
+
+	D2D1_ELLIPSE ellipse = D2D1::Ellipse(D2D1::Point2F(x, y), radius, radius);
+	target->FillEllipse(ellipse, brush);
+	MarkDirty(x - radius - 1.0f, y - radius - 1.0f, x + radius + 1.0f, y + radius + 1.0f);
+}
+
+
+void Graphics::DrawParticles(const ParticleSystem& particles, int size, BlendMode mode)
+{
+	if (particles.Size() == 0 || !CanUseFramebuffer()) return;
+
+	// Sized for the whole pool once, so drawing never reallocates afterwards
+	size_t capacity = particles.GetCapacity();
+	if (pointX.capacity() < capacity)
+	{
+		pointX.reserve(capacity);
+		pointY.reserve(capacity);
+		pointColors.reserve(capacity);
+	}
+
+	// Window pixel of each particle in view, centered on its position
+	size_t count = particles.Size();
+	pointX.resize(count);
+	pointY.resize(count);
+	pointColors.resize(count);
+	D2D1_RECT_F view = GetViewport();
+	float halfSize = 0.5f * size;
+	size_t visible = 0;
+	for (size_t it = 0; it < count; it++)
+	{
+		float x = particles.x[it];
+		float y = particles.y[it];
+		if (x + halfSize < view.left || x - halfSize >= view.right ||
+			y + halfSize < view.top || y - halfSize >= view.bottom) continue;
+		pointX[visible] = (int)floorf(x - halfSize - cameraX);
+		pointY[visible] = (int)floorf(y - halfSize - cameraY);
+		pointColors[visible] = particles.color[it];
+		visible++;
+	}
+	if (visible == 0) return;
+
+	// One blend pass and one upload for the whole system
+	canvas->SetBlendMode(mode);
+	canvas->DrawSquares(pointX.data(), pointY.data(), pointColors.data(), visible, size);
+	canvas->SetBlendMode(BLEND_OVER);
+	FlushFramebuffer(mode);
+}
 
 // Existing Methods Implementation (LineDDA, etc.) remain unchanged
 // ... [Other methods like LineDDA, LineBresenham, etc.] ...
@@ -506,21 +1388,27 @@ void Graphics::BoundaryFill(float x, float y, D2D1::ColorF fill, D2D1::ColorF bo
 
 void Graphics::CreateBitmap()
 {
+	if (bitmap) bitmap->Release();
+	bitmap = nullptr;
+
+	// Premultiplied like the framebuffer, so uploads are plain copies
 	D2D1_BITMAP_PROPERTIES bitmapProperties = D2D1::BitmapProperties(
-		D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_IGNORE)
+		D2D1::PixelFormat(DXGI_FORMAT_B8G8R8A8_UNORM, D2D1_ALPHA_MODE_PREMULTIPLIED)
 	);
-	renderTarget->CreateBitmap(
+	HRESULT hr = renderTarget->CreateBitmap(
 		size,
 		nullptr,
 		0,
 		bitmapProperties,
 		&bitmap
 	);
+	if (FAILED(hr) || bitmap == nullptr) {
+		std::cerr << "Failed to create framebuffer bitmap." << std::endl;
+		bitmap = nullptr;
+		return;
+	}
 
-	ID3D10Texture2D* d3dTexture;
-	IDXGISurface* sharedSurface;
-
-	//TODO
+	framebuffer.Resize(size.width, size.height);
 }
 
 int Graphics::ComputeOutCode(float x, float y, float xwmin, float ywmin, float xwmax, float ywmax) {
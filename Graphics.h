@@ -1,19 +1,34 @@
 // Graphics.h
 #pragma once
 
-#include <d2d1.h>
+#include <d2d1_1.h>
+#include <d3d11.h>
+#include <dxgi1_2.h>
 #include <wincodec.h>
 #include <vector>
 #include <utility> // For std::pair
+#include "Terrain.h"
+#include "Framebuffer.h"
+#include "Particles.h"
 
 #define ROUND(a) ((int)(a + 0.5f))
 #define PI 3.14159265f
+#define LAYER_TILE_SIZE 256 // Edge length of a cached static layer tile
+#define MAX_DIRTY_RECTS 64  // A frame that changes more regions than this is presented whole
+
+// How frames reach the window
+enum GraphicsBackend {
+    GRAPHICS_BACKEND_HWND,           // ID2D1HwndRenderTarget
+    GRAPHICS_BACKEND_DEVICE_CONTEXT, // ID2D1DeviceContext on a flip-model DXGI swap chain
+    GRAPHICS_BACKEND_SOFTWARE        // Framebuffer on the CPU, copied to the window with GDI or kept headless
+};
 
 // Structure for a Cannon
 struct Cannon {
     float x;     // X-coordinate position on the hill
     float y;     // Y-coordinate position on the hill
-    float angle; // Firing angle in radians
+    float dirX;  // Unit firing direction, X component
+    float dirY;  // Unit firing direction, Y component
 };
 
 // Structure for a Cannonball
@@ -24,16 +39,78 @@ struct Cannonball {
     float vy; // Velocity in Y direction
 };
 
+class Graphics;
+
+// Callback that draws the static layer (sky, hills, cannon bases) in world coordinates
+typedef void (*StaticLayerDrawFn)(Graphics* graphics);
+
 class Graphics
 {
 private:
     ID2D1Factory* factory;
-    ID2D1HwndRenderTarget* renderTarget;
+    ID2D1HwndRenderTarget* hwndTarget;
+    ID2D1RenderTarget* renderTarget; // Window target of the active backend
+    ID2D1RenderTarget* target; // Target the drawing methods write to (window or layer tile)
     ID2D1SolidColorBrush* brush;
-    ID2D1Bitmap* bitmap;
+    D2D1_COLOR_F brushColor; // Kept here too, the software backend has no brush
+    ID2D1Bitmap* bitmap; // Receives the framebuffer, window sized
+
+    // CPU blending for per-pixel draws; the touched part is uploaded to bitmap.
+    // It holds one batch at a time on a transparent background, so the batch's
+    // blend mode is applied again when the bitmap is drawn onto the scene.
+    // The software backend draws the whole frame into it instead.
+    Framebuffer framebuffer;
+    Framebuffer* canvas; // Framebuffer the CPU drawing writes to (frame or software layer)
+    std::vector<int> pointX;
+    std::vector<int> pointY;
+    std::vector<Pixel> pointColors;
 
     D2D1_SIZE_U size;
 
+    // Camera: world position of the top-left corner of the viewport
+    float cameraX;
+    float cameraY;
+
+    // Device context backend: presents through a swap chain instead of the HWND target
+    GraphicsBackend backend;
+    HWND window;
+    ID3D11Device* d3dDevice;
+    ID2D1Device* d2dDevice;
+    ID2D1DeviceContext* deviceContext;
+    IDXGISwapChain1* swapChain;
+    ID2D1Bitmap1* backBuffer;
+
+    // Changed regions in window pixels, this frame and the one before, so a still
+    // camera presents only what moved
+    std::vector<RECT> dirtyRects;
+    std::vector<RECT> previousDirtyRects;
+    std::vector<RECT> presentRects;
+    bool dirtyOverflow;
+    bool previousDirtyOverflow;
+    bool fullPresent; // Next frame must be presented whole (new target, layer rebuilt)
+    float presentedCameraX;
+    float presentedCameraY;
+
+    // Static layer cache: rasterized once into tiles, rebuilt only after invalidation.
+    // The device context backend records it into a command list instead.
+    std::vector<ID2D1BitmapRenderTarget*> layerTiles;
+    ID2D1CommandList* layerCommands;
+    UINT layerWidth;
+    UINT layerHeight;
+    UINT layerColumns;
+    UINT layerRows;
+    bool recordingLayer;
+
+    // Software backend: the static layer rasterized once for the whole world
+    Framebuffer layerPixels;
+    bool layerValid;
+
+    // Terrain bitmaps, one per tile; rows are re-uploaded only when the terrain marks them dirty
+    std::vector<ID2D1Bitmap*> terrainTiles;
+    UINT terrainColumns;
+    UINT terrainRows;
+    std::vector<UINT32> terrainPixels; // Scratch buffer for expanding terrain bits
+
     // Private helper methods
     D2D1_COLOR_F GetBrushColor();
     void SetBrushColor(D2D1_COLOR_F color);
@@ -47,24 +124,67 @@ private:
     void BoundaryFill4(float x, float y, D2D1::ColorF fill, D2D1::ColorF boundary);
     void BoundaryFill8(float x, float y, D2D1::ColorF fill, D2D1::ColorF boundary);
 
+    bool InitDeviceContext(HWND windowHandle);
+    bool CreateBackBuffer();
+    void ReleaseDeviceContext();
+    void MarkDirty(float left, float top, float right, float bottom);
+    void Present();
+
+    void DrawStaticLayerCommands(StaticLayerDrawFn drawLayer);
+    void DrawStaticLayerSoftware(StaticLayerDrawFn drawLayer);
+    void DrawTerrainSoftware(const Terrain& terrain);
+    void PresentSoftware();
+
+    // Software rasterization into canvas, in world coordinates; a pixel is
+    // covered when its center is inside the shape
+    Pixel GetBrushPixel();
+    void FillRectSoftware(float left, float top, float right, float bottom);
+    void FillCircleSoftware(float centerX, float centerY, float radius);
+    void FillConvexSoftware(const D2D1_POINT_2F* points, int count);
+    bool CanUseFramebuffer();
+    void FlushFramebuffer(BlendMode mode = BLEND_OVER);
+    void ReleaseStaticLayer();
+    void ReleaseTerrain();
+    void UploadTerrainRows(const Terrain& terrain, int firstRow, int lastRow);
+    void GetVisibleTiles(UINT columns, UINT rows, int& firstColumn, int& firstRow, int& lastColumn, int& lastRow);
+
 public:
     Graphics();
     ~Graphics();
 
-    bool Init(HWND windowHandle);
+    // Falls back to the HWND backend when the device context one cannot be created
+    bool Init(HWND windowHandle, GraphicsBackend requestedBackend = GRAPHICS_BACKEND_HWND);
+    // Software backend without a window or any Direct2D object, for tests and
+    // tools; every frame is left in GetFramebuffer
+    bool InitSoftware(UINT width, UINT height);
+    GraphicsBackend GetBackend() const { return backend; }
+    const Framebuffer& GetFramebuffer() const { return framebuffer; }
+    void Resize(UINT width, UINT height);
 
-    void BeginDraw() { renderTarget->BeginDraw(); }
-    void EndDraw() { renderTarget->EndDraw(); }
+    void BeginDraw();
+    void EndDraw();
 
     void ClearScreen();
     void DrawPoint(float x, float y);
     void DrawPoints(std::vector<std::pair<float, float>> points, std::vector<D2D1::ColorF> intensity);
+    void SetCamera(float x, float y);
+    D2D1_RECT_F GetViewport();
+
+    // Static Layer Cache
+    void SetStaticLayerSize(UINT width, UINT height);
+    void InvalidateStaticLayer();
+    void DrawStaticLayer(StaticLayerDrawFn drawLayer);
 
     // New Drawing Methods for the Game
     void DrawHill(float centerX, float centerY, float radius);
+    void DrawTerrain(Terrain& terrain);
     void DrawCannon(const Cannon& cannon);
+    void DrawCannonBase(const Cannon& cannon);
+    void DrawCannonBarrel(const Cannon& cannon);
     void DrawCannonball(const Cannonball& cannonball);
     void DrawCharacter(float x, float y, float radius);
+    void DrawSurvivor(float x, float y, float radius);
+    void DrawParticles(const ParticleSystem& particles, int size, BlendMode mode);
 
     // Existing Drawing Methods
     void LineDDA(float xa, float ya, float xb, float yb);
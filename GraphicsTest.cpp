@@ -0,0 +1,143 @@
+// GraphicsTest.cpp
+// Renders frames with the software backend, without a window or a GPU, and
+// checks the pixels. Graphics.cpp still links against Direct2D:
+//   cl /O2 /EHsc GraphicsTest.cpp Graphics.cpp Framebuffer.cpp Terrain.cpp Particles.cpp FastMath.cpp d2d1.lib user32.lib gdi32.lib
+#include "Graphics.h"
+#include <cstdio>
+
+const int VIEW_WIDTH = 320;
+const int VIEW_HEIGHT = 240;
+const int WORLD_WIDTH = 640;
+const int WORLD_HEIGHT = 480;
+
+const Pixel SKY = PackPremultiplied(0.529f, 0.808f, 0.922f, 1.0f);
+const Pixel SOLID = 0xFF008000; // TERRAIN_SOLID in Graphics.cpp
+const Pixel BLACK = 0xFF000000;
+
+static int failures = 0;
+
+static void CheckPixel(const Graphics& graphics, int x, int y, Pixel expected, const char* what)
+{
+    Pixel actual = graphics.GetFramebuffer().GetRow(y)[x];
+    if (actual == expected) return;
+    printf("FAIL %s at (%d, %d): %08X, expected %08X\n", what, x, y, actual, expected);
+    failures++;
+}
+
+static void Check(bool condition, const char* what)
+{
+    if (condition) return;
+    printf("FAIL %s\n", what);
+    failures++;
+}
+
+static void DrawSky(Graphics* graphics)
+{
+    graphics->ClearScreen();
+}
+
+// Sky, then the terrain, as the game draws the start of every frame
+static void DrawScene(Graphics& graphics, Terrain& terrain, float cameraX, float cameraY)
+{
+    graphics.BeginDraw();
+    graphics.SetCamera(cameraX, cameraY);
+    graphics.DrawStaticLayer(DrawSky);
+    graphics.DrawTerrain(terrain);
+}
+
+static void TestTerrain(Graphics& graphics, Terrain& terrain)
+{
+    DrawScene(graphics, terrain, 0.0f, 0.0f);
+    graphics.EndDraw();
+    CheckPixel(graphics, 160, 220, SOLID, "hill");
+    CheckPixel(graphics, 160, 100, SKY, "sky above the hill");
+
+    // A carved crater shows the sky again on the next frame
+    terrain.Carve(160.0f, 180.0f, 10.0f);
+    DrawScene(graphics, terrain, 0.0f, 0.0f);
+    graphics.EndDraw();
+    CheckPixel(graphics, 160, 180, SKY, "crater");
+    CheckPixel(graphics, 160, 220, SOLID, "hill below the crater");
+}
+
+static void TestCamera(Graphics& graphics, Terrain& terrain)
+{
+    // World (160, 220) is drawn at the window pixel the camera offset puts it on
+    DrawScene(graphics, terrain, 100.0f, 100.0f);
+    Cannonball cannonball = { 200.0f, 150.0f, 0.0f, 0.0f };
+    graphics.DrawCannonball(cannonball);
+    graphics.EndDraw();
+    CheckPixel(graphics, 60, 120, SOLID, "hill under a moved camera");
+    CheckPixel(graphics, 100, 50, BLACK, "cannonball under a moved camera");
+
+    // Past the edge of the world there is only sky
+    DrawScene(graphics, terrain, (float)(WORLD_WIDTH - 100), (float)(WORLD_HEIGHT - 100));
+    graphics.EndDraw();
+    CheckPixel(graphics, VIEW_WIDTH - 1, VIEW_HEIGHT - 1, SKY, "outside the world");
+}
+
+static void TestParticles(Graphics& graphics, Terrain& terrain)
+{
+    ParticleSystem particles;
+    particles.Init(16, 0.0f, 1.0f, 1);
+
+    ParticleBurst burst = {};
+    burst.x = 40.5f;
+    burst.y = 40.5f;
+    burst.minLife = 10.0f;
+    burst.maxLife = 10.0f;
+    burst.color = PackPremultiplied(0.5f, 0.0f, 0.0f, 0.5f);
+    burst.count = 1;
+    particles.Emit(burst);
+
+    // Additive: the sky shows through, brightened by the particle
+    DrawScene(graphics, terrain, 0.0f, 0.0f);
+    graphics.DrawParticles(particles, 1, BLEND_ADD);
+    graphics.EndDraw();
+    CheckPixel(graphics, 40, 40, BlendAdd(burst.color, SKY), "additive particle");
+
+    // Over: half covered
+    DrawScene(graphics, terrain, 0.0f, 0.0f);
+    graphics.DrawParticles(particles, 1, BLEND_OVER);
+    graphics.EndDraw();
+    CheckPixel(graphics, 40, 40, BlendOver(burst.color, SKY), "blended particle");
+    CheckPixel(graphics, 41, 40, SKY, "next to the particle");
+
+    // A particle out of view leaves the frame alone
+    DrawScene(graphics, terrain, 200.0f, 0.0f);
+    graphics.DrawParticles(particles, 1, BLEND_OVER);
+    graphics.EndDraw();
+    bool untouched = true;
+    const Framebuffer& frame = graphics.GetFramebuffer();
+    for (int y = 0; y < 100; y++) {
+        for (int x = 0; x < VIEW_WIDTH; x++) {
+            if (frame.GetRow(y)[x] != SKY) untouched = false;
+        }
+    }
+    Check(untouched, "particle out of view");
+}
+
+int main()
+{
+    Graphics graphics;
+    if (!graphics.InitSoftware(VIEW_WIDTH, VIEW_HEIGHT)) {
+        printf("InitSoftware failed\n");
+        return 1;
+    }
+    graphics.SetStaticLayerSize(WORLD_WIDTH, WORLD_HEIGHT);
+
+    Terrain terrain;
+    terrain.Init(WORLD_WIDTH, WORLD_HEIGHT);
+    terrain.AddHill(160.0f, 160.0f, 80.0f);
+
+    TestTerrain(graphics, terrain);
+    TestCamera(graphics, terrain);
+    TestParticles(graphics, terrain);
+
+    if (failures) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+// InputQueue.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// A key transition as seen by the message thread
+struct InputEvent {
+    uint8_t key; // Virtual-key code
+    bool down;   // true for WM_KEYDOWN, false for WM_KEYUP
+};
+
+// Lock-free single-producer/single-consumer ring of input events. The window
+// procedure pushes, the simulation drains at the start of each tick. Each
+// index is written by one side only, so acquire/release ordering is enough.
+//
+// Key releases are never lost: one that does not fit in a full ring is
+// coalesced into a per-key bit instead, which the consumer applies after the
+// ring. A later press of the same key first moves its pending release into
+// the ring, so the two still arrive in order. Only presses are dropped.
+class InputQueue
+{
+private:
+    static const size_t CAPACITY = 256; // Power of two
+    InputEvent events[CAPACITY];
+    alignas(64) std::atomic<size_t> head; // Next event to read, owned by the consumer
+    alignas(64) std::atomic<size_t> tail; // Next slot to write, owned by the producer
+    alignas(64) std::atomic<uint64_t> pendingUp[4]; // Releases that did not fit, one bit per key
+
+    bool Write(const InputEvent& event)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+
+        events[t & (CAPACITY - 1)] = event;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+public:
+    InputQueue() : head(0), tail(0)
+    {
+        for (auto& word : pendingUp) word.store(0, std::memory_order_relaxed);
+    }
+
+    // Producer side; false when a key press was dropped because the ring is full
+    bool Push(const InputEvent& event)
+    {
+        std::atomic<uint64_t>& pending = pendingUp[event.key >> 6];
+        uint64_t bit = 1ULL << (event.key & 63);
+
+        if (!event.down) {
+            if (!Write(event)) pending.fetch_or(bit, std::memory_order_release);
+            return true;
+        }
+
+        // A release of this key still waiting outside the ring goes in first
+        if (pending.fetch_and(~bit, std::memory_order_acq_rel) & bit) {
+            InputEvent release = event;
+            release.down = false;
+            if (!Write(release)) {
+                pending.fetch_or(bit, std::memory_order_release);
+                return false;
+            }
+        }
+        return Write(event);
+    }
+
+    // Consumer side; false when the ring is empty
+    bool Pop(InputEvent& event)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+
+        event = events[h & (CAPACITY - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, after Pop returned false: takes the coalesced releases.
+    // Each is newer than any event of its key popped so far.
+    void TakePendingReleases(uint64_t releases[4])
+    {
+        for (int w = 0; w < 4; w++) releases[w] = pendingUp[w].exchange(0, std::memory_order_acq_rel);
+    }
+};
+
+// Keyboard state for one tick, built by draining the queue
+struct InputState {
+    bool down[256];    // Held after the last event of the tick
+    bool pressed[256]; // Went down at some point since the previous tick
+
+    InputState() : down(), pressed() {}
+
+    void Drain(InputQueue& queue)
+    {
+        for (auto& p : pressed) p = false;
+
+        InputEvent event;
+        while (queue.Pop(event)) {
+            down[event.key] = event.down;
+            if (event.down) pressed[event.key] = true;
+        }
+
+        uint64_t releases[4];
+        queue.TakePendingReleases(releases);
+        for (int key = 0; key < 256; key++) {
+            if ((releases[key >> 6] >> (key & 63)) & 1) down[key] = false;
+        }
+    }
+
+    // A tap that went down and up between two ticks still counts for this tick
+    bool IsActive(uint8_t key) const { return down[key] || pressed[key]; }
+};
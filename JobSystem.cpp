@@ -0,0 +1,141 @@
+#include "JobSystem.h"
+
+JobSystem::JobSystem()
+{
+    queued = 0;
+    stopping = false;
+}
+
+JobSystem::~JobSystem()
+{
+    Shutdown();
+}
+
+void JobSystem::Init(unsigned workerCount)
+{
+    Shutdown();
+
+    if (workerCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 0;
+    }
+
+    stopping = false;
+    for (unsigned i = 0; i <= workerCount; i++) queues.push_back(new JobQueue());
+    for (unsigned i = 1; i <= workerCount; i++) workers.emplace_back(&JobSystem::WorkerLoop, this, (size_t)i);
+}
+
+void JobSystem::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+
+    for (auto queue : queues) delete queue;
+    queues.clear();
+}
+
+bool JobSystem::Pop(size_t thread, Job& job)
+{
+    JobQueue* queue = queues[thread];
+    std::lock_guard<std::mutex> guard(queue->lock);
+    if (queue->jobs.empty()) return false;
+
+    job = queue->jobs.back();
+    queue->jobs.pop_back();
+    queued--;
+    return true;
+}
+
+bool JobSystem::Steal(size_t thread, Job& job)
+{
+    // Start at the next deque so thieves spread over their victims
+    for (size_t offset = 1; offset < queues.size(); offset++)
+    {
+        JobQueue* queue = queues[(thread + offset) % queues.size()];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        if (queue->jobs.empty()) continue;
+
+        job = queue->jobs.front();
+        queue->jobs.pop_front();
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::Find(size_t thread, Job& job)
+{
+    return Pop(thread, job) || Steal(thread, job);
+}
+
+void JobSystem::Execute(const Job& job)
+{
+    job.body(job.context, job.begin, job.end);
+    job.pending->fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::WorkerLoop(size_t thread)
+{
+    Job job;
+    while (true)
+    {
+        if (Find(thread, job)) {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wake.wait(guard, [this] { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
+
+void JobSystem::Run(size_t count, size_t chunkSize, void (*body)(void*, size_t, size_t), void* context)
+{
+    if (count == 0) return;
+    if (chunkSize == 0) chunkSize = 1;
+
+    // Not worth splitting, or no workers to split across
+    if (queues.size() < 2 || count <= chunkSize) {
+        body(context, 0, count);
+        return;
+    }
+
+    size_t chunks = (count + chunkSize - 1) / chunkSize;
+    std::atomic<size_t> pending(chunks);
+
+    // Deal the chunks round-robin so every deque starts with local work
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        Job job;
+        job.body = body;
+        job.context = context;
+        job.begin = chunk * chunkSize;
+        job.end = job.begin + chunkSize < count ? job.begin + chunkSize : count;
+        job.pending = &pending;
+
+        JobQueue* queue = queues[chunk % queues.size()];
+        std::lock_guard<std::mutex> guard(queue->lock);
+        queue->jobs.push_back(job);
+        queued++;
+    }
+    {
+        // Taking the lock orders the notify after any worker's predicate check
+        std::lock_guard<std::mutex> guard(sleepLock);
+    }
+    wake.notify_all();
+
+    // The calling thread works through deque 0 and then steals until the batch is done
+    Job job;
+    while (pending.load(std::memory_order_acquire) > 0)
+    {
+        if (Find(0, job)) Execute(job);
+        else std::this_thread::yield();
+    }
+}
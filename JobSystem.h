@@ -0,0 +1,64 @@
+// JobSystem.h
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+
+// A chunk of a parallel-for: body(context, begin, end)
+struct Job {
+    void (*body)(void* context, size_t begin, size_t end);
+    void* context;
+    size_t begin;
+    size_t end;
+    std::atomic<size_t>* pending; // Chunks of the batch still running
+};
+
+// One deque per thread. Owners pop from the back of their own deque; threads
+// that run dry steal from the front of the others.
+struct JobQueue {
+    std::mutex lock;
+    std::deque<Job> jobs;
+};
+
+// Work-stealing job system: one worker per core besides the calling thread,
+// which takes part in every ParallelFor and owns deque 0.
+class JobSystem
+{
+private:
+    std::vector<std::thread> workers;
+    std::vector<JobQueue*> queues;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<size_t> queued;
+    bool stopping;
+
+    bool Pop(size_t thread, Job& job);
+    bool Steal(size_t thread, Job& job);
+    bool Find(size_t thread, Job& job);
+    void Execute(const Job& job);
+    void WorkerLoop(size_t thread);
+    void Run(size_t count, size_t chunkSize, void (*body)(void*, size_t, size_t), void* context);
+
+public:
+    JobSystem();
+    ~JobSystem();
+
+    // workerCount 0 uses one worker per remaining hardware thread
+    void Init(unsigned workerCount = 0);
+    void Shutdown();
+
+    // Calls body(begin, end) over [0, count) in chunks of chunkSize and returns
+    // once every chunk has run. Chunks must write disjoint data.
+    template <typename Fn>
+    void ParallelFor(size_t count, size_t chunkSize, const Fn& body)
+    {
+        Run(count, chunkSize,
+            [](void* context, size_t begin, size_t end) { (*(const Fn*)context)(begin, end); },
+            (void*)&body);
+    }
+};
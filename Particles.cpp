@@ -0,0 +1,133 @@
+#include "Particles.h"
+#include "FastMath.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PARTICLES_SSE2
+#include <emmintrin.h>
+#endif
+
+ParticleSystem::ParticleSystem()
+{
+    count = 0;
+    gravity = 0.0f;
+    drag = 1.0f;
+    rng = 1;
+}
+
+void ParticleSystem::Init(size_t capacity, float particleGravity, float particleDrag, uint32_t seed)
+{
+    count = 0;
+    gravity = particleGravity;
+    drag = particleDrag;
+    rng = seed ? seed : 1;
+
+    x.resize(capacity);
+    y.resize(capacity);
+    vx.resize(capacity);
+    vy.resize(capacity);
+    life.resize(capacity);
+    inverseLifetime.resize(capacity);
+    baseColor.resize(capacity);
+    color.resize(capacity);
+    angles.resize(capacity);
+    sines.resize(capacity);
+    cosines.resize(capacity);
+}
+
+// Uniform in [0, 1), xorshift
+float ParticleSystem::Random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (float)(rng >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::Move(size_t from, size_t to)
+{
+    x[to] = x[from];
+    y[to] = y[from];
+    vx[to] = vx[from];
+    vy[to] = vy[from];
+    life[to] = life[from];
+    inverseLifetime[to] = inverseLifetime[from];
+    baseColor[to] = baseColor[from];
+    color[to] = color[from];
+}
+
+void ParticleSystem::Emit(const ParticleBurst& burst)
+{
+    size_t room = GetCapacity() - count;
+    size_t n = burst.count < room ? burst.count : room;
+    if (n == 0) return;
+
+    // Directions for the whole burst go through the batched sincos
+    for (size_t i = 0; i < n; i++) {
+        angles[i] = burst.angle + (Random() - 0.5f) * burst.spread;
+    }
+    FastSinCosBatch(angles.data(), sines.data(), cosines.data(), n);
+
+    for (size_t i = 0; i < n; i++) {
+        size_t p = count + i;
+        float speed = burst.minSpeed + Random() * (burst.maxSpeed - burst.minSpeed);
+        float lifetime = burst.minLife + Random() * (burst.maxLife - burst.minLife);
+        if (lifetime < 1.0f) lifetime = 1.0f;
+
+        x[p] = burst.x;
+        y[p] = burst.y;
+        vx[p] = cosines[i] * speed;
+        vy[p] = sines[i] * speed;
+        life[p] = lifetime;
+        inverseLifetime[p] = 1.0f / lifetime;
+        baseColor[p] = burst.color;
+        color[p] = burst.color;
+    }
+    count += n;
+}
+
+void ParticleSystem::Update()
+{
+    float* px = x.data();
+    float* py = y.data();
+    float* pvx = vx.data();
+    float* pvy = vy.data();
+    float* plife = life.data();
+    size_t i = 0;
+
+#ifdef PARTICLES_SSE2
+    const __m128 dragV = _mm_set1_ps(drag);
+    const __m128 gravityV = _mm_set1_ps(gravity);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 velocityX = _mm_mul_ps(_mm_loadu_ps(pvx + i), dragV);
+        __m128 velocityY = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pvy + i), dragV), gravityV);
+        _mm_storeu_ps(pvx + i, velocityX);
+        _mm_storeu_ps(pvy + i, velocityY);
+        _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), velocityX));
+        _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), velocityY));
+        _mm_storeu_ps(plife + i, _mm_sub_ps(_mm_loadu_ps(plife + i), one));
+    }
+#endif
+
+    for (; i < count; i++) {
+        pvx[i] = pvx[i] * drag;
+        pvy[i] = pvy[i] * drag + gravity;
+        px[i] += pvx[i];
+        py[i] += pvy[i];
+        plife[i] -= 1.0f;
+    }
+
+    // Expired particles take the last live one, which is then checked in their slot
+    i = 0;
+    while (i < count) {
+        if (plife[i] <= 0.0f) {
+            Move(--count, i);
+            continue;
+        }
+        uint32_t coverage = (uint32_t)(plife[i] * inverseLifetime[i] * 255.0f + 0.5f);
+        color[i] = ScalePixel(baseColor[i], coverage);
+        i++;
+    }
+}
@@ -0,0 +1,64 @@
+// Particles.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Framebuffer.h"
+
+// One burst of particles from a point, in a cone around a direction
+struct ParticleBurst {
+    float x;         // Origin
+    float y;
+    float angle;     // Cone direction in radians, 0 along +X, +Y down
+    float spread;    // Full cone width in radians, 2 pi for all directions
+    float minSpeed;  // Units per tick
+    float maxSpeed;
+    float minLife;   // Ticks
+    float maxLife;
+    Pixel color;     // Premultiplied color at spawn, fades out with the remaining life
+    size_t count;
+};
+
+// Fixed-capacity particle pool stored as a structure of arrays. Live particles
+// are packed at [0, Size()); an expired one is replaced by the last live one,
+// so nothing is allocated after Init and bursts past the capacity are cut short.
+class ParticleSystem
+{
+public:
+    std::vector<float> x;         // Current X positions
+    std::vector<float> y;         // Current Y positions
+    std::vector<float> vx;        // Velocities in X direction
+    std::vector<float> vy;        // Velocities in Y direction
+    std::vector<float> life;      // Ticks left
+    std::vector<float> inverseLifetime; // 1 / life at spawn, for fading
+    std::vector<Pixel> baseColor; // Color at spawn
+    std::vector<Pixel> color;     // Faded color for drawing
+
+    ParticleSystem();
+
+    // gravity is added to vy and both velocities are scaled by drag every tick
+    void Init(size_t capacity, float gravity, float drag, uint32_t seed);
+    void Clear() { count = 0; }
+    size_t Size() const { return count; }
+    size_t GetCapacity() const { return x.size(); }
+
+    void Emit(const ParticleBurst& burst);
+
+    // Integrate all particles, drop the expired ones and update the faded colors
+    void Update();
+
+private:
+    size_t count;
+    float gravity;
+    float drag;
+    uint32_t rng;
+
+    // Scratch for the burst directions, capacity long
+    std::vector<float> angles;
+    std::vector<float> sines;
+    std::vector<float> cosines;
+
+    float Random();
+    void Move(size_t from, size_t to);
+};
@@ -0,0 +1,124 @@
+#include "ProjectileScheduler.h"
+#include <algorithm>
+#include <cmath>
+
+// Orders the heap so the smallest wakeTick is on top
+static bool WakesLater(const DormantProjectile& a, const DormantProjectile& b)
+{
+    return a.wakeTick > b.wakeTick;
+}
+
+// Smallest positive n where a coordinate stepped with semi-implicit Euler,
+// p(n) = p0 + n v + a n (n + 1) / 2, reaches limit; 1e30 when it never does
+static float TicksToReach(float position, float velocity, float accel, float limit)
+{
+    float a = 0.5f * accel;
+    float b = velocity + 0.5f * accel;
+    float c = position - limit;
+
+    if (a == 0.0f) {
+        float n = b != 0.0f ? -c / b : -1.0f;
+        return n > 0.0f ? n : 1e30f;
+    }
+
+    float discriminant = b * b - 4.0f * a * c;
+    if (discriminant < 0.0f) return 1e30f;
+
+    float root = sqrtf(discriminant);
+    float n0 = (-b - root) / (2.0f * a);
+    float n1 = (-b + root) / (2.0f * a);
+    if (n0 > n1) {
+        float t = n0;
+        n0 = n1;
+        n1 = t;
+    }
+    if (n0 > 0.0f) return n0;
+    if (n1 > 0.0f) return n1;
+    return 1e30f;
+}
+
+// Ticks until the projectile leaves [0, limit] on one axis
+static float TicksToLeave(float position, float velocity, float accel, float limit)
+{
+    float low = TicksToReach(position, velocity, accel, 0.0f);
+    float high = TicksToReach(position, velocity, accel, limit);
+    return low < high ? low : high;
+}
+
+ProjectileScheduler::ProjectileScheduler()
+{
+    worldWidth = 0.0f;
+    worldHeight = 0.0f;
+    gravity = 0.0f;
+}
+
+void ProjectileScheduler::Init(float width, float height, float g)
+{
+    worldWidth = width;
+    worldHeight = height;
+    gravity = g;
+    heap.clear();
+}
+
+void ProjectileScheduler::Schedule(DormantProjectile& p, uint64_t tick, float distance, float speed, float interestRadius, float maxApproachSpeed)
+{
+    // The gap to the interest region closes at most by the projectile speed,
+    // which gravity grows by g per tick, plus the speed the region itself moves:
+    // gap <= k (speed + approach) + g k (k + 1) / 2
+    float gap = distance - interestRadius;
+    float linear = speed + maxApproachSpeed + 0.5f * gravity;
+    float ticks;
+    if (gravity > 0.0f) ticks = (sqrtf(linear * linear + 2.0f * gravity * gap) - linear) / gravity;
+    else ticks = linear > 0.0f ? gap / linear : 1e30f;
+
+    uint64_t wake = tick + 1;
+    if (ticks > 1.0f) wake = ticks < 1e18f ? tick + (uint64_t)ticks : p.expireTick;
+    p.wakeTick = wake < p.expireTick ? wake : p.expireTick;
+
+    heap.push_back(p);
+    std::push_heap(heap.begin(), heap.end(), WakesLater);
+}
+
+void ProjectileScheduler::Demote(float x, float y, float vx, float vy, uint64_t tick, float centerX, float centerY, float interestRadius, float maxApproachSpeed)
+{
+    DormantProjectile p;
+    p.x0 = x;
+    p.y0 = y;
+    p.vx = vx;
+    p.vy = vy;
+    p.t0 = tick;
+
+    float ticksToLeaveX = TicksToLeave(p.x0, p.vx, 0.0f, worldWidth);
+    float ticksToLeaveY = TicksToLeave(p.y0, p.vy, gravity, worldHeight);
+    float ticksToLeave = ticksToLeaveX < ticksToLeaveY ? ticksToLeaveX : ticksToLeaveY;
+    p.expireTick = ticksToLeave < 1e18f ? tick + 1 + (uint64_t)ticksToLeave : UINT64_MAX;
+
+    float dx = p.x0 - centerX;
+    float dy = p.y0 - centerY;
+    Schedule(p, tick, sqrtf(dx * dx + dy * dy), sqrtf(vx * vx + vy * vy), interestRadius, maxApproachSpeed);
+}
+
+void ProjectileScheduler::Wake(uint64_t tick, float centerX, float centerY, float interestRadius, float maxApproachSpeed, ProjectileArrays& active)
+{
+    while (!heap.empty() && heap.front().wakeTick <= tick)
+    {
+        std::pop_heap(heap.begin(), heap.end(), WakesLater);
+        DormantProjectile p = heap.back();
+        heap.pop_back();
+
+        // Left the world while dormant
+        if (tick >= p.expireTick) continue;
+
+        // Closed-form position after the previous tick, this tick's move follows
+        float elapsed = (float)(tick - 1 - p.t0);
+        float x = p.x0 + p.vx * elapsed;
+        float y = p.y0 + p.vy * elapsed + 0.5f * gravity * elapsed * (elapsed + 1.0f);
+        float vy = p.vy + gravity * elapsed;
+
+        float dx = x - centerX;
+        float dy = y - centerY;
+        float distance = sqrtf(dx * dx + dy * dy);
+        if (distance <= interestRadius) active.Push(x, y, p.vx, vy);
+        else Schedule(p, tick, distance, sqrtf(p.vx * p.vx + vy * vy), interestRadius, maxApproachSpeed);
+    }
+}
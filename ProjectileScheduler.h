@@ -0,0 +1,50 @@
+// ProjectileScheduler.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include "Projectiles.h"
+
+// A projectile outside the interest region. Its position is not integrated
+// every tick; it follows in closed form from the state it was demoted with:
+// x0 + vx t, and y0 + vy t + g t (t + 1) / 2 under gravity.
+struct DormantProjectile {
+    float x0;            // X position after tick t0
+    float y0;            // Y position after tick t0
+    float vx;            // Velocity in X direction
+    float vy;            // Velocity in Y direction
+    uint64_t t0;         // Tick the projectile was demoted on
+    uint64_t wakeTick;   // Earliest tick it could reach the interest region
+    uint64_t expireTick; // Tick it leaves the world
+};
+
+// Level-of-detail scheduler: distant projectiles sleep in a min-heap keyed by
+// the earliest tick they could matter, so tick cost follows the relevant set
+// rather than the total projectile count.
+class ProjectileScheduler
+{
+private:
+    std::vector<DormantProjectile> heap;
+    float worldWidth;
+    float worldHeight;
+    float gravity; // Added to vy every tick, matching the active step
+
+    void Schedule(DormantProjectile& p, uint64_t tick, float distance, float speed, float interestRadius, float maxApproachSpeed);
+
+public:
+    ProjectileScheduler();
+
+    void Init(float worldWidth, float worldHeight, float gravity);
+    void Clear() { heap.clear(); }
+
+    // The heap array as is, for snapshots; a saved heap is restored without reordering
+    const std::vector<DormantProjectile>& GetDormant() const { return heap; }
+    void Restore(const DormantProjectile* dormant, size_t count) { heap.assign(dormant, dormant + count); }
+
+    // The projectile has already been moved on this tick
+    void Demote(float x, float y, float vx, float vy, uint64_t tick, float centerX, float centerY, float interestRadius, float maxApproachSpeed);
+
+    // Called before moving on this tick: projectiles inside the interest region
+    // are appended to active at their closed-form position, the rest sleep again
+    void Wake(uint64_t tick, float centerX, float centerY, float interestRadius, float maxApproachSpeed, ProjectileArrays& active);
+};
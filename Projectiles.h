@@ -0,0 +1,50 @@
+// Projectiles.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Active projectiles stored as a structure of arrays, so the simulation step
+// streams through each field and parallel chunks write disjoint ranges.
+struct ProjectileArrays {
+    std::vector<float> x;  // Current X positions
+    std::vector<float> y;  // Current Y positions
+    std::vector<float> vx; // Velocities in X direction
+    std::vector<float> vy; // Velocities in Y direction
+
+    size_t Size() const { return x.size(); }
+
+    void Push(float px, float py, float pvx, float pvy)
+    {
+        x.push_back(px);
+        y.push_back(py);
+        vx.push_back(pvx);
+        vy.push_back(pvy);
+    }
+
+    void Clear()
+    {
+        x.clear();
+        y.clear();
+        vx.clear();
+        vy.clear();
+    }
+
+    // Stable compaction: moves entry from down to slot to
+    void Move(size_t from, size_t to)
+    {
+        x[to] = x[from];
+        y[to] = y[from];
+        vx[to] = vx[from];
+        vy[to] = vy[from];
+    }
+
+    void Resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+        vx.resize(count);
+        vy.resize(count);
+    }
+};
@@ -0,0 +1,174 @@
+#include "Snapshot.h"
+#include <Windows.h>
+#include <iostream>
+
+static size_t AlignUp(size_t n)
+{
+    return (n + SNAPSHOT_ALIGN - 1) & ~(SNAPSHOT_ALIGN - 1);
+}
+
+SnapshotWriter::SnapshotWriter()
+{
+    blockCount = 0;
+}
+
+void SnapshotWriter::Begin(uint32_t version)
+{
+    SnapshotHeader header = {};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = version;
+
+    data.resize(sizeof(header));
+    memcpy(data.data(), &header, sizeof(header));
+    blockCount = 0;
+}
+
+void SnapshotWriter::WriteBlock(uint32_t tag, const void* bytes, size_t size)
+{
+    SnapshotBlock block = {};
+    block.tag = tag;
+    block.size = size;
+
+    size_t offset = data.size();
+    data.resize(offset + sizeof(block) + AlignUp(size));
+    memcpy(&data[offset], &block, sizeof(block));
+    if (size) memcpy(&data[offset + sizeof(block)], bytes, size);
+    blockCount++;
+}
+
+void SnapshotWriter::End()
+{
+    SnapshotHeader* header = (SnapshotHeader*)data.data();
+    header->blockCount = blockCount;
+    header->size = data.size();
+}
+
+bool SnapshotWriter::SaveToFile(const wchar_t* path) const
+{
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to create snapshot file." << std::endl;
+        return false;
+    }
+
+    // WriteFile takes a DWORD byte count, so large snapshots go out in chunks
+    const uint8_t* bytes = data.data();
+    size_t remaining = data.size();
+    while (remaining > 0) {
+        DWORD chunk = remaining > 0x40000000 ? 0x40000000 : (DWORD)remaining;
+        DWORD written = 0;
+        if (!WriteFile(file, bytes, chunk, &written, NULL) || written == 0) {
+            std::cerr << "Failed to write snapshot file." << std::endl;
+            CloseHandle(file);
+            return false;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+
+    CloseHandle(file);
+    return true;
+}
+
+SnapshotReader::SnapshotReader()
+{
+    data = NULL;
+    size = 0;
+    file = NULL;
+    mapping = NULL;
+}
+
+SnapshotReader::~SnapshotReader()
+{
+    Close();
+}
+
+bool SnapshotReader::Open(const void* bytes, size_t byteCount)
+{
+    blocks.clear();
+    data = (const uint8_t*)bytes;
+    size = byteCount;
+
+    SnapshotHeader header;
+    if (!data || size < sizeof(header)) return false;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.size < sizeof(header) || header.size > size) return false;
+    if (header.version > SNAPSHOT_VERSION) return false; // Written by a newer build
+
+    // Index the blocks, rejecting any that run past the end
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; i < header.blockCount; i++) {
+        if (offset > header.size || header.size - offset < sizeof(SnapshotBlock)) return false;
+        const SnapshotBlock* block = (const SnapshotBlock*)(data + offset);
+        offset += sizeof(SnapshotBlock);
+        if (block->size > header.size - offset) return false;
+        blocks.push_back(block);
+        offset += AlignUp((size_t)block->size);
+    }
+
+    return true;
+}
+
+bool SnapshotReader::OpenFile(const wchar_t* path)
+{
+    Close();
+
+    HANDLE fileHandle = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open snapshot file." << std::endl;
+        return false;
+    }
+    file = fileHandle;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(SnapshotHeader)) {
+        std::cerr << "Snapshot file is too small." << std::endl;
+        Close();
+        return false;
+    }
+
+    // Map the file instead of reading it: blocks are copied out of the view
+    // directly and pages that are never touched are never read
+    mapping = CreateFileMapping(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!view) {
+        std::cerr << "Failed to map snapshot file." << std::endl;
+        Close();
+        return false;
+    }
+
+    if (!Open(view, (size_t)fileSize.QuadPart)) {
+        std::cerr << "Snapshot file is invalid." << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotReader::Close()
+{
+    if (mapping) {
+        if (data) UnmapViewOfFile(data);
+        CloseHandle(mapping);
+        mapping = NULL;
+    }
+    if (file) {
+        CloseHandle(file);
+        file = NULL;
+    }
+    blocks.clear();
+    data = NULL;
+    size = 0;
+}
+
+const void* SnapshotReader::FindBlock(uint32_t tag, size_t& blockSize) const
+{
+    for (const SnapshotBlock* block : blocks) {
+        if (block->tag == tag) {
+            blockSize = (size_t)block->size;
+            return block + 1;
+        }
+    }
+    blockSize = 0;
+    return NULL;
+}
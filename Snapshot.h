@@ -0,0 +1,106 @@
+// Snapshot.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Versioned binary snapshot: a header followed by tagged blocks of raw bytes.
+// Each payload starts on a 16-byte boundary, so arrays written from the SoA
+// vectors can be copied straight back, including from a mapped file.
+const uint32_t SNAPSHOT_MAGIC = 0x4E534E43; // "CNSN"
+const uint32_t SNAPSHOT_VERSION = 1;
+const size_t SNAPSHOT_ALIGN = 16;
+
+#define SNAPSHOT_TAG(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t blockCount;
+    uint32_t reserved;
+    uint64_t size; // Total bytes including this header
+    uint64_t padding;
+};
+
+struct SnapshotBlock {
+    uint32_t tag;
+    uint32_t reserved;
+    uint64_t size; // Payload bytes, not counting the padding after them
+};
+
+// Builds a snapshot in memory. The buffer keeps its capacity between
+// snapshots, so writing the same state again does not allocate.
+class SnapshotWriter
+{
+private:
+    std::vector<uint8_t> data;
+    uint32_t blockCount;
+
+public:
+    SnapshotWriter();
+
+    void Begin(uint32_t version = SNAPSHOT_VERSION);
+    void WriteBlock(uint32_t tag, const void* bytes, size_t size);
+    void End();
+
+    template <typename T>
+    void WriteValue(uint32_t tag, const T& value) { WriteBlock(tag, &value, sizeof(T)); }
+
+    template <typename T>
+    void WriteArray(uint32_t tag, const std::vector<T>& values) { WriteBlock(tag, values.data(), values.size() * sizeof(T)); }
+
+    const uint8_t* GetData() const { return data.data(); }
+    size_t GetSize() const { return data.size(); }
+
+    bool SaveToFile(const wchar_t* path) const;
+};
+
+// Reads a snapshot in place, either from memory or from a file mapped
+// read-only. Blocks are looked up by tag; unknown tags are skipped, so older
+// readers can open snapshots with extra blocks.
+class SnapshotReader
+{
+private:
+    const uint8_t* data;
+    size_t size;
+    std::vector<const SnapshotBlock*> blocks;
+    void* file;    // HANDLE of a mapped file
+    void* mapping; // HANDLE of its mapping
+
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    // The bytes are not copied and must outlive the reader
+    bool Open(const void* bytes, size_t byteCount);
+    bool OpenFile(const wchar_t* path);
+    void Close();
+
+    const void* FindBlock(uint32_t tag, size_t& blockSize) const;
+
+    template <typename T>
+    bool ReadValue(uint32_t tag, T& value) const
+    {
+        size_t blockSize;
+        const void* bytes = FindBlock(tag, blockSize);
+        if (!bytes || blockSize != sizeof(T)) return false;
+        memcpy(&value, bytes, sizeof(T));
+        return true;
+    }
+
+    template <typename T>
+    bool ReadArray(uint32_t tag, std::vector<T>& values) const
+    {
+        size_t blockSize;
+        const void* bytes = FindBlock(tag, blockSize);
+        if (!bytes || blockSize % sizeof(T) != 0) return false;
+        values.resize(blockSize / sizeof(T));
+        if (blockSize) memcpy(values.data(), bytes, blockSize);
+        return true;
+    }
+};
@@ -0,0 +1,53 @@
+#include "SpatialGrid.h"
+
+SpatialGrid::SpatialGrid()
+{
+    cellSize = 1.0f;
+    columns = 0;
+    rows = 0;
+}
+
+void SpatialGrid::Init(float worldWidth, float worldHeight, float size)
+{
+    cellSize = size;
+    columns = (int)(worldWidth / size) + 1;
+    rows = (int)(worldHeight / size) + 1;
+    cellStart.assign((size_t)columns * rows + 1, 0);
+    entries.clear();
+}
+
+// Positions outside the world fall into the border cells
+int SpatialGrid::CellColumn(float x) const
+{
+    int column = (int)(x / cellSize);
+    if (column < 0) return 0;
+    if (column >= columns) return columns - 1;
+    return column;
+}
+
+int SpatialGrid::CellRow(float y) const
+{
+    int row = (int)(y / cellSize);
+    if (row < 0) return 0;
+    if (row >= rows) return rows - 1;
+    return row;
+}
+
+void SpatialGrid::Build(const float* x, const float* y, size_t count)
+{
+    entityCell.resize(count);
+    entries.resize(count);
+    for (auto& start : cellStart) start = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint32_t cell = CellRow(y[i]) * columns + CellColumn(x[i]);
+        entityCell[i] = cell;
+        cellStart[cell]++;
+    }
+
+    // Inclusive prefix sum leaves each cell's end; scattering backwards walks
+    // it down to the cell's start and keeps indices ascending within a cell
+    for (size_t c = 1; c + 1 < cellStart.size(); c++) cellStart[c] += cellStart[c - 1];
+    cellStart.back() = (uint32_t)count;
+    for (size_t i = count; i-- > 0; ) entries[--cellStart[entityCell[i]]] = (uint32_t)i;
+}
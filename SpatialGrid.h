@@ -0,0 +1,47 @@
+// SpatialGrid.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Uniform grid broadphase over the world. Rebuilt every tick with a counting
+// sort so entities of one cell are contiguous and queries touch only the
+// cells that overlap the query rectangle.
+class SpatialGrid
+{
+private:
+    float cellSize;
+    int columns;
+    int rows;
+    std::vector<uint32_t> cellStart; // First entry of each cell, plus one past the end
+    std::vector<uint32_t> entries;   // Entity indices sorted by cell
+    std::vector<uint32_t> entityCell;
+
+    int CellColumn(float x) const;
+    int CellRow(float y) const;
+
+public:
+    SpatialGrid();
+
+    void Init(float worldWidth, float worldHeight, float cellSize);
+
+    // Indices refer to the position arrays and stay valid until those change
+    void Build(const float* x, const float* y, size_t count);
+
+    // Calls visit(index) for every entity in a cell overlapping the rectangle
+    template <typename Fn>
+    void Query(float left, float top, float right, float bottom, Fn visit) const
+    {
+        int firstColumn = CellColumn(left), lastColumn = CellColumn(right);
+        int firstRow = CellRow(top), lastRow = CellRow(bottom);
+
+        for (int row = firstRow; row <= lastRow; row++) {
+            for (int column = firstColumn; column <= lastColumn; column++) {
+                int cell = row * columns + column;
+                for (uint32_t e = cellStart[cell]; e < cellStart[cell + 1]; e++)
+                    visit(entries[e]);
+            }
+        }
+    }
+};
@@ -0,0 +1,168 @@
+#include "Swarm.h"
+#include <cmath>
+
+static uint32_t NextRandom(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Uniform in [-0.5, 0.5]
+static float RandomCentered(uint32_t& state)
+{
+    return (float)(NextRandom(state) & 0xffff) / 65535.0f - 0.5f;
+}
+
+Swarm::Swarm()
+{
+    deaths = 0;
+    settings = SwarmSettings();
+}
+
+void Swarm::Init(size_t count, const SwarmSettings& swarmSettings, uint32_t seed)
+{
+    settings = swarmSettings;
+    deaths = 0;
+
+    x.resize(count);
+    y.resize(count);
+    vx.assign(count, 0.0f);
+    vy.assign(count, 0.0f);
+    hit.assign(count, 0);
+    rng.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        rng[i] = seed ^ (uint32_t)(i * 2654435761u);
+        if (rng[i] == 0) rng[i] = 1;
+        Place(i);
+    }
+}
+
+void Swarm::Place(size_t i)
+{
+    // Anywhere above the hills
+    float margin = settings.radius;
+    x[i] = margin + (RandomCentered(rng[i]) + 0.5f) * (settings.worldWidth - 2.0f * margin);
+    y[i] = margin + (RandomCentered(rng[i]) + 0.5f) * (settings.worldHeight * 0.75f - 2.0f * margin);
+    vx[i] = 0.0f;
+    vy[i] = 0.0f;
+}
+
+void Swarm::Step(size_t begin, size_t end, const ProjectileArrays& projectiles, const SpatialGrid& projectileGrid, const Terrain& terrain)
+{
+    const float* px = projectiles.x.data();
+    const float* py = projectiles.y.data();
+    const float* pvx = projectiles.vx.data();
+    const float* pvy = projectiles.vy.data();
+    const float threat = settings.threatRadius;
+    const float danger = settings.dangerRadius;
+
+    for (size_t i = begin; i < end; i++)
+    {
+        float sx = x[i];
+        float sy = y[i];
+        float ax = 0.0f;
+        float ay = 0.0f;
+
+        // Dodge: push away from where each nearby cannonball passes closest
+        projectileGrid.Query(sx - threat, sy - threat, sx + threat, sy + threat, [&](uint32_t b) {
+            float rx = sx - px[b];
+            float ry = sy - py[b];
+            float bvx = pvx[b];
+            float bvy = pvy[b];
+            float speedSq = bvx * bvx + bvy * bvy;
+            if (speedSq <= 0.0f) return;
+
+            float t = (rx * bvx + ry * bvy) / speedSq;
+            if (t < 0.0f || t > settings.lookahead) return;
+
+            float dx = rx - bvx * t;
+            float dy = ry - bvy * t;
+            float distanceSq = dx * dx + dy * dy;
+            if (distanceSq >= danger * danger) return;
+
+            float distance = sqrtf(distanceSq);
+            float nx, ny;
+            if (distance > 1e-3f) {
+                nx = dx / distance;
+                ny = dy / distance;
+            }
+            else {
+                // Dead on: step sideways to the ball's path
+                float invSpeed = 1.0f / sqrtf(speedSq);
+                nx = -bvy * invSpeed;
+                ny = bvx * invSpeed;
+            }
+
+            float weight = (1.0f - distance / danger) * (1.0f - t / settings.lookahead);
+            ax += nx * weight;
+            ay += ny * weight;
+        });
+
+        ax = ax * settings.maxAccel + RandomCentered(rng[i]) * settings.wander;
+        ay = ay * settings.maxAccel + RandomCentered(rng[i]) * settings.wander;
+        float accelSq = ax * ax + ay * ay;
+        if (accelSq > settings.maxAccel * settings.maxAccel) {
+            float scale = settings.maxAccel / sqrtf(accelSq);
+            ax *= scale;
+            ay *= scale;
+        }
+
+        // Integrate with light damping and a speed cap
+        float nvx = (vx[i] + ax) * 0.98f;
+        float nvy = (vy[i] + ay) * 0.98f;
+        float speedSq = nvx * nvx + nvy * nvy;
+        if (speedSq > settings.maxSpeed * settings.maxSpeed) {
+            float scale = settings.maxSpeed / sqrtf(speedSq);
+            nvx *= scale;
+            nvy *= scale;
+        }
+        sx += nvx;
+        sy += nvy;
+
+        // Bounce off the hills: stay put and reverse instead of entering the ground
+        if (terrain.OverlapsCircle(sx, sy, settings.radius)) {
+            sx = x[i];
+            sy = y[i];
+            nvx = -nvx;
+            nvy = -nvy;
+        }
+
+        // Bounce off the world edges
+        if (sx < settings.radius || sx > settings.worldWidth - settings.radius) {
+            nvx = -nvx;
+            sx = sx < settings.radius ? settings.radius : settings.worldWidth - settings.radius;
+        }
+        if (sy < settings.radius || sy > settings.worldHeight - settings.radius) {
+            nvy = -nvy;
+            sy = sy < settings.radius ? settings.radius : settings.worldHeight - settings.radius;
+        }
+
+        x[i] = sx;
+        y[i] = sy;
+        vx[i] = nvx;
+        vy[i] = nvy;
+
+        // Hit test against the cannonballs around the new position
+        const float reach = settings.hitRadius;
+        uint8_t wasHit = 0;
+        projectileGrid.Query(sx - reach, sy - reach, sx + reach, sy + reach, [&](uint32_t b) {
+            float dx = px[b] - sx;
+            float dy = py[b] - sy;
+            if (dx * dx + dy * dy <= reach * reach) wasHit = 1;
+        });
+        hit[i] = wasHit;
+    }
+}
+
+void Swarm::Respawn()
+{
+    for (size_t i = 0; i < x.size(); i++) {
+        if (!hit[i]) continue;
+        hit[i] = 0;
+        deaths++;
+        Place(i);
+    }
+}
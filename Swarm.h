@@ -0,0 +1,55 @@
+// Swarm.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Projectiles.h"
+#include "SpatialGrid.h"
+#include "Terrain.h"
+
+// Tuning for the AI survivors
+struct SwarmSettings {
+    float radius;       // Survivor radius for drawing and hits
+    float hitRadius;    // Survivor plus cannonball radius
+    float maxSpeed;     // Units per tick
+    float maxAccel;     // Steering change per tick
+    float wander;       // Random jitter added to the steering
+    float threatRadius; // Cannonballs further away are ignored
+    float dangerRadius; // Predicted misses closer than this are dodged
+    float lookahead;    // Ticks ahead a near miss is predicted
+    float worldWidth;
+    float worldHeight;
+};
+
+// Thousands of AI survivors dodging cannonballs, stored as a structure of
+// arrays. Step is a batched kernel over a range of survivors that only writes
+// that range, so it can run as parallel-for chunks.
+class Swarm
+{
+public:
+    std::vector<float> x;      // Current X positions
+    std::vector<float> y;      // Current Y positions
+    std::vector<float> vx;     // Velocities in X direction
+    std::vector<float> vy;     // Velocities in Y direction
+    std::vector<uint32_t> rng; // Per-survivor xorshift state
+    std::vector<uint8_t> hit;  // Set by Step when a cannonball reached the survivor
+    size_t deaths;
+
+    Swarm();
+
+    void Init(size_t count, const SwarmSettings& settings, uint32_t seed);
+    size_t Size() const { return x.size(); }
+
+    // Steer away from predicted hits found through the broadphase, move, then test for hits.
+    // Moves into solid terrain are refused, so survivors bounce off the hills.
+    void Step(size_t begin, size_t end, const ProjectileArrays& projectiles, const SpatialGrid& projectileGrid, const Terrain& terrain);
+
+    // Serial, in index order: survivors that were hit respawn elsewhere to keep the load constant
+    void Respawn();
+
+private:
+    SwarmSettings settings;
+
+    void Place(size_t i);
+};
@@ -0,0 +1,177 @@
+#include "Terrain.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit, v must be non-zero
+static int LowestBit(uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (int)index;
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// Mask with bits a..b (inclusive) set
+static uint64_t BitRange(int a, int b)
+{
+    return (~0ULL << a) & (~0ULL >> (63 - b));
+}
+
+Terrain::Terrain()
+{
+    width = 0;
+    height = 0;
+    wordsPerRow = 0;
+}
+
+void Terrain::Init(int w, int h)
+{
+    width = w;
+    height = h;
+    wordsPerRow = (w + 63) / 64;
+    bits.assign((size_t)wordsPerRow * h, 0);
+    dirtyRows.assign((h + 63) / 64, 0);
+    MarkAllDirty();
+}
+
+bool Terrain::Restore(const uint64_t* words, size_t count)
+{
+    if (count != bits.size()) return false;
+
+    // Only rows that differ are copied and marked, so stepping between
+    // nearby states re-rasterizes just the craters that changed
+    size_t rowBytes = (size_t)wordsPerRow * sizeof(uint64_t);
+    for (int y = 0; y < height; y++) {
+        const uint64_t* source = words + (size_t)y * wordsPerRow;
+        uint64_t* row = &bits[(size_t)y * wordsPerRow];
+        if (memcmp(row, source, rowBytes) == 0) continue;
+        memcpy(row, source, rowBytes);
+        dirtyRows[y >> 6] |= 1ULL << (y & 63);
+    }
+    return true;
+}
+
+bool Terrain::IsSolid(int x, int y) const
+{
+    if (x < 0 || x >= width || y < 0 || y >= height) return false;
+    return (GetRow(y)[x >> 6] >> (x & 63)) & 1;
+}
+
+// Horizontal extent of a circle on row y, clamped to the terrain; false if empty
+bool Terrain::CircleSpan(float centerX, float centerY, float radius, int y, int& x0, int& x1) const
+{
+    float dy = (float)y - centerY;
+    float halfSq = radius * radius - dy * dy;
+    if (halfSq < 0.0f) return false;
+
+    float half = sqrtf(halfSq);
+    x0 = (int)ceilf(centerX - half);
+    x1 = (int)floorf(centerX + half);
+    if (x0 < 0) x0 = 0;
+    if (x1 >= width) x1 = width - 1;
+    return x0 <= x1;
+}
+
+void Terrain::SetSpan(int y, int x0, int x1, bool solid)
+{
+    uint64_t* row = &bits[(size_t)y * wordsPerRow];
+    int w0 = x0 >> 6;
+    int w1 = x1 >> 6;
+
+    for (int w = w0; w <= w1; w++) {
+        uint64_t mask = BitRange(w == w0 ? (x0 & 63) : 0, w == w1 ? (x1 & 63) : 63);
+        if (solid) row[w] |= mask;
+        else row[w] &= ~mask;
+    }
+    dirtyRows[y >> 6] |= 1ULL << (y & 63);
+}
+
+bool Terrain::SpanSolid(int y, int x0, int x1) const
+{
+    const uint64_t* row = GetRow(y);
+    int w0 = x0 >> 6;
+    int w1 = x1 >> 6;
+
+    for (int w = w0; w <= w1; w++) {
+        uint64_t mask = BitRange(w == w0 ? (x0 & 63) : 0, w == w1 ? (x1 & 63) : 63);
+        if (row[w] & mask) return true;
+    }
+    return false;
+}
+
+bool Terrain::OverlapsCircle(float centerX, float centerY, float radius) const
+{
+    int yMin = (int)ceilf(centerY - radius);
+    int yMax = (int)floorf(centerY + radius);
+    if (yMin < 0) yMin = 0;
+    if (yMax >= height) yMax = height - 1;
+
+    int x0, x1;
+    for (int y = yMin; y <= yMax; y++) {
+        if (CircleSpan(centerX, centerY, radius, y, x0, x1) && SpanSolid(y, x0, x1))
+            return true;
+    }
+    return false;
+}
+
+void Terrain::AddHill(float centerX, float centerY, float radius)
+{
+    // Lower half of the circle, matching Graphics::DrawHill
+    int yMin = (int)ceilf(centerY);
+    int yMax = (int)floorf(centerY + radius);
+    if (yMin < 0) yMin = 0;
+    if (yMax >= height) yMax = height - 1;
+
+    int x0, x1;
+    for (int y = yMin; y <= yMax; y++) {
+        if (CircleSpan(centerX, centerY, radius, y, x0, x1))
+            SetSpan(y, x0, x1, true);
+    }
+}
+
+void Terrain::Carve(float centerX, float centerY, float radius)
+{
+    int yMin = (int)ceilf(centerY - radius);
+    int yMax = (int)floorf(centerY + radius);
+    if (yMin < 0) yMin = 0;
+    if (yMax >= height) yMax = height - 1;
+
+    int x0, x1;
+    for (int y = yMin; y <= yMax; y++) {
+        if (CircleSpan(centerX, centerY, radius, y, x0, x1) && SpanSolid(y, x0, x1))
+            SetSpan(y, x0, x1, false);
+    }
+}
+
+int Terrain::NextDirtyRow(int from) const
+{
+    if (from < 0) from = 0;
+    if (from >= height) return -1;
+
+    size_t w = from >> 6;
+    uint64_t word = dirtyRows[w] & (~0ULL << (from & 63));
+    while (!word) {
+        if (++w >= dirtyRows.size()) return -1;
+        word = dirtyRows[w];
+    }
+    return (int)(w * 64) + LowestBit(word);
+}
+
+void Terrain::MarkAllDirty()
+{
+    for (auto& word : dirtyRows) word = ~0ULL;
+    // Keep the bits past the last row clear so NextDirtyRow stays in range
+    if (height & 63) dirtyRows.back() = BitRange(0, (height & 63) - 1);
+}
+
+void Terrain::ClearDirtyRows()
+{
+    for (auto& word : dirtyRows) word = 0;
+}
@@ -0,0 +1,48 @@
+// Terrain.h
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Destructible terrain stored as a bitmask: 1 bit per pixel, rows of 64-bit words.
+// Bit i of word w in a row is the pixel at x = w * 64 + i.
+class Terrain
+{
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<uint64_t> bits;
+    std::vector<uint64_t> dirtyRows; // 1 bit per row changed since the last ClearDirtyRows
+
+    void SetSpan(int y, int x0, int x1, bool solid);
+    bool SpanSolid(int y, int x0, int x1) const;
+    bool CircleSpan(float centerX, float centerY, float radius, int y, int& x0, int& x1) const;
+
+public:
+    Terrain();
+
+    void Init(int width, int height);
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetWordsPerRow() const { return wordsPerRow; }
+    const uint64_t* GetRow(int y) const { return &bits[(size_t)y * wordsPerRow]; }
+
+    // All rows back to back, for snapshots. Restore marks the rows it changed dirty.
+    const std::vector<uint64_t>& GetBits() const { return bits; }
+    bool Restore(const uint64_t* words, size_t count);
+
+    bool IsSolid(int x, int y) const;
+    bool OverlapsCircle(float centerX, float centerY, float radius) const;
+
+    // Editing: both mark the touched rows dirty
+    void AddHill(float centerX, float centerY, float radius);
+    void Carve(float centerX, float centerY, float radius);
+
+    // Dirty row tracking for incremental re-rasterization
+    int NextDirtyRow(int from) const;
+    void MarkAllDirty();
+    void ClearDirtyRows();
+};
@@ -3,7 +3,22 @@
 #include <wincodec.h>
 #include <vector>
 #include <cmath>
+#include <cwchar>
+#include <cwctype>
+#include <string>
 #include "Graphics.h"
+#include "Terrain.h"
+#include "SpatialGrid.h"
+#include "ProjectileScheduler.h"
+#include "Projectiles.h"
+#include "JobSystem.h"
+#include "InputQueue.h"
+#include "Swarm.h"
+#include "Ballistics.h"
+#include "Snapshot.h"
+#include "Particles.h"
+#include "FastMath.h"
+#include <iostream>
 #include <time.h>
 using namespace std;
 
@@ -12,31 +27,166 @@ using namespace std;
 #define HEIGHT 600
 #define PI 3.14159265f
 
+// World dimensions: the camera scrolls over a world larger than the window
+#define WORLD_WIDTH 4800
+#define WORLD_HEIGHT 1200
+#define HILL_SPACING 800.0f
+
 // Global Variables
 Graphics* graphics;
 HWND g_hwnd; // Global window handle for access in WindowProc
 
-// Game Entities
-Cannon leftCannon = { 100.0f, HEIGHT - 100.0f, -PI / 4.0f };      // Left hill, initial firing angle
-Cannon rightCannon = { WIDTH - 100.0f, HEIGHT - 100.0f, -3.0f * PI / 4.0f }; // Right hill, initial firing angle
+// Game Entities: one cannon on top of each hill along the bottom of the world
+vector<Cannon> cannons;
 
-pair<float, float> characterPos = { WIDTH / 2.0f, HEIGHT / 2.0f }; // Character Position (Center)
+pair<float, float> characterPos = { WORLD_WIDTH / 2.0f, WORLD_HEIGHT / 2.0f }; // Character Position (Center)
 const float CHARACTER_RADIUS = 20.0f; // Radius for collision detection and drawing
 
-// Container for Cannonballs
-vector<Cannonball> cannonballs;
-
-// Timing for cannon firing
-ULONGLONG lastFireTimeLeft = 0;
-ULONGLONG lastFireTimeRight = 0;
+// Container for Cannonballs, stored as arrays per field
+ProjectileArrays cannonballs;
+const float CANNONBALL_RADIUS = 5.0f;
+
+// Parallel Simulation: the step runs as parallel-for chunks over the cannonball
+// arrays and records one outcome per ball, which is then reduced in index order
+JobSystem jobs;
+const size_t PROJECTILE_CHUNK = 4096;
+
+enum ProjectileOutcome : uint8_t {
+    PROJECTILE_ALIVE,
+    PROJECTILE_LEFT_WORLD,
+    PROJECTILE_HIT_TERRAIN,
+    PROJECTILE_HIT_CHARACTER,
+    PROJECTILE_DORMANT
+};
+vector<uint8_t> outcomes;
+
+// Broadphase over the cannonballs, rebuilt every tick for culling and collision
+SpatialGrid projectileGrid;
+const float GRID_CELL_SIZE = 128.0f;
+
+// Level of Detail: cannonballs outside the interest region around the character
+// are advanced in closed form by the scheduler and skip terrain tests until woken
+ProjectileScheduler dormantCannonballs;
+const float INTEREST_MARGIN = 100.0f; // Added to the viewport diagonal
+const float DEMOTE_HYSTERESIS = 64.0f; // Extra distance before an active ball goes dormant
+ULONGLONG simTick = 0;
+
+// Destructible Terrain: hills are carved by cannonballs that hit them
+Terrain terrain;
+const float HILL_RADIUS = 100.0f;
+const float CRATER_RADIUS = 20.0f;
+
+// Timing for cannon firing, one entry per cannon
+vector<ULONGLONG> lastFireTimes;
 const ULONGLONG fireInterval = 1000; // 2 seconds between shots
 
-// Keyboard Input Tracking
-bool keys[256] = { false };
+// Ballistics (-gravity [g]): cannonballs fall under gravity and cannons lead
+// their target; solutions are cached per cannon until the target strays
+float gravity = 0.0f;
+const float DEFAULT_GRAVITY = 0.05f; // Units per tick squared
+const float CANNONBALL_SPEED = 10.0f;
+const float BARREL_LENGTH = 30.0f;
+const float AIM_TOLERANCE = 8.0f; // Distance from the predicted path before re-solving
+vector<AimSolution> aimCache;
+
+// Swarm Mode (-swarm [count]): AI survivors dodge the cannonballs as a
+// simulation load generator; cannons fire faster and target the survivors
+bool swarmMode = false;
+Swarm swarm;
+SpatialGrid survivorGrid; // Rebuilt every tick for culling
+const size_t DEFAULT_SWARM_SIZE = 2000;
+const size_t SWARM_CHUNK = 512;
+const float SURVIVOR_RADIUS = 6.0f;
+const ULONGLONG swarmFireInterval = 100;
+
+// Particle Effects: smoke and flashes at the barrel tips, debris and sparks
+// where cannonballs land. Purely visual, so snapshots leave them out.
+ParticleSystem smoke;  // Drifts up and slows down, blended over
+ParticleSystem debris; // Falls, blended over
+ParticleSystem sparks; // Short lived, blended additively
+const size_t SMOKE_CAPACITY = 65536;
+const size_t DEBRIS_CAPACITY = 32768;
+const size_t SPARK_CAPACITY = 16384;
+
+// Keyboard Input Tracking: WindowProc queues key events, and each
+// tick drains them into its own input state so taps between ticks are kept
+InputQueue inputQueue;
+InputState input;
+
+// Snapshots: the game state as tagged raw blocks. F5 saves it to disk and F9
+// loads it back through a read-only mapping, holding Backspace steps back
+// through a ring of recent states, and a new game restores the startup state.
+const wchar_t* SAVE_FILE = L"savegame.snap";
+SnapshotWriter initialSnapshot;
+SnapshotWriter saveSnapshot;
+
+// Rewind ring, bounded by bytes. Slots leave the terrain out: each keeps only
+// the rows that changed before the next slot was written, as they were at its
+// own time, and rewindTerrain holds the terrain of the newest slot. Stepping
+// back restores rewindTerrain, then undoes the previous slot's rows into it.
+struct RewindSlot {
+    SnapshotWriter state;      // Everything but the terrain
+    vector<uint32_t> undoRows; // Terrain rows that changed before the next slot
+    vector<uint64_t> undoBits; // Their words at the time of this slot
+};
+const ULONGLONG REWIND_INTERVAL = 6; // Ticks between rewind snapshots
+const size_t REWIND_SLOTS = 1000;
+const size_t REWIND_BUDGET = 16 * 1024 * 1024; // Oldest slots are dropped past this many bytes
+vector<RewindSlot> rewindRing(REWIND_SLOTS);
+vector<uint64_t> rewindTerrain;
+size_t rewindNext = 0;  // Slot the next rewind snapshot goes into
+size_t rewindCount = 0; // Filled slots before rewindNext
+
+// Settings a snapshot has to match to be loaded
+struct SnapshotConfig {
+    float worldWidth;
+    float worldHeight;
+    float gravity;
+    uint32_t cannonCount;
+    uint32_t swarmMode;
+};
+
+enum SnapshotTag : uint32_t {
+    TAG_CONFIG = SNAPSHOT_TAG('C', 'N', 'F', 'G'),
+    TAG_TICK = SNAPSHOT_TAG('T', 'I', 'C', 'K'),
+    TAG_CHARACTER = SNAPSHOT_TAG('C', 'H', 'A', 'R'),
+    TAG_CANNONS = SNAPSHOT_TAG('C', 'A', 'N', 'N'),
+    TAG_FIRE_AGES = SNAPSHOT_TAG('F', 'I', 'R', 'E'),
+    TAG_BALL_X = SNAPSHOT_TAG('B', 'L', 'X', ' '),
+    TAG_BALL_Y = SNAPSHOT_TAG('B', 'L', 'Y', ' '),
+    TAG_BALL_VX = SNAPSHOT_TAG('B', 'L', 'V', 'X'),
+    TAG_BALL_VY = SNAPSHOT_TAG('B', 'L', 'V', 'Y'),
+    TAG_DORMANT = SNAPSHOT_TAG('D', 'O', 'R', 'M'),
+    TAG_TERRAIN = SNAPSHOT_TAG('T', 'E', 'R', 'R'),
+    TAG_SURVIVOR_X = SNAPSHOT_TAG('S', 'V', 'X', ' '),
+    TAG_SURVIVOR_Y = SNAPSHOT_TAG('S', 'V', 'Y', ' '),
+    TAG_SURVIVOR_VX = SNAPSHOT_TAG('S', 'V', 'V', 'X'),
+    TAG_SURVIVOR_VY = SNAPSHOT_TAG('S', 'V', 'V', 'Y'),
+    TAG_SURVIVOR_RNG = SNAPSHOT_TAG('S', 'V', 'R', 'N'),
+    TAG_SURVIVOR_DEATHS = SNAPSHOT_TAG('S', 'V', 'D', 'E')
+};
+
+// Command Line: whitespace separated tokens; flags only match a whole token
+vector<wstring> commandLine;
 
 // Function Prototypes
 void update(HWND hwnd);
 void render();
+void renderStaticLayer(Graphics* g);
+void buildCannons();
+void buildTerrain();
+void resetGame();
+void buildSwarm(size_t count);
+void writeSnapshot(SnapshotWriter& writer, bool includeTerrain = true);
+void emitMuzzleEffects(const Cannon& cannon);
+void emitImpactEffects(float x, float y, Pixel debrisColor);
+bool readSnapshot(const SnapshotReader& reader, const vector<uint64_t>* terrainBits = NULL);
+bool restoreSnapshot(const SnapshotReader& reader);
+void recordRewind();
+bool stepRewind();
+void updateParticles();
+void parseCommandLine(const wchar_t* line);
+bool commandLineFlag(const wchar_t* flag, double* value = NULL);
 
 // Window Procedure
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
@@ -45,12 +195,22 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
         PostQuitMessage(0);
         return 0;
 
-    case WM_KEYDOWN:
-        if (wParam < 256) keys[wParam] = true;
+    case WM_SIZE:
+        // Cached static layer tiles are rebuilt for the new size
+        if (graphics) graphics->Resize(LOWORD(lParam), HIWORD(lParam));
         return 0;
 
+    case WM_KEYDOWN:
     case WM_KEYUP:
-        if (wParam < 256) keys[wParam] = false;
+        // Skip auto-repeat (bit 30: the key was already down). The key is held
+        // anyway, and a repeat would make one-shot keys like F5 and F9 fire again.
+        if (uMsg == WM_KEYDOWN && (lParam & (1 << 30))) return 0;
+        if (wParam < 256) {
+            InputEvent event;
+            event.key = (uint8_t)wParam;
+            event.down = uMsg == WM_KEYDOWN;
+            inputQueue.Push(event);
+        }
         return 0;
 
     case WM_MOUSEMOVE:
@@ -61,132 +221,634 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hwnd, uMsg, wParam, lParam);
 }
 
-// Function to calculate angle from cannon to character
-float CalculateAngle(float cannonX, float cannonY, float targetX, float targetY) {
-    float deltaX = targetX - cannonX;
-    float deltaY = targetY - cannonY;
-    float angle = atan2f(deltaY, deltaX);
-    return angle;
+// Split the command line into tokens
+void parseCommandLine(const wchar_t* line) {
+    commandLine.clear();
+    if (!line) return;
+
+    wstring token;
+    for (const wchar_t* c = line; ; c++) {
+        if (*c != 0 && !iswspace(*c)) {
+            token += *c;
+            continue;
+        }
+        if (!token.empty()) commandLine.push_back(token);
+        token.clear();
+        if (*c == 0) break;
+    }
 }
 
-// Update Function: Handles game logic
-void update(HWND hwnd) {
-    ULONGLONG currentTime = GetTickCount64();
+// True when flag is one of the tokens. If the token after it is a number,
+// it is stored in value; otherwise value is left as is.
+bool commandLineFlag(const wchar_t* flag, double* value) {
+    for (size_t i = 0; i < commandLine.size(); i++) {
+        if (commandLine[i] != flag) continue;
+
+        if (value && i + 1 < commandLine.size()) {
+            const wchar_t* number = commandLine[i + 1].c_str();
+            wchar_t* end = NULL;
+            double parsed = wcstod(number, &end);
+            if (end != number && *end == 0) *value = parsed;
+        }
+        return true;
+    }
+    return false;
+}
 
-    // Update cannon angles to aim toward the character
-    leftCannon.angle = CalculateAngle(leftCannon.x, leftCannon.y, characterPos.first, characterPos.second);
-    rightCannon.angle = CalculateAngle(rightCannon.x, rightCannon.y, characterPos.first, characterPos.second);
+// Place one cannon on top of each hill, spaced evenly across the world
+void buildCannons() {
+    cannons.clear();
+    for (float x = HILL_SPACING / 2.0f; x < WORLD_WIDTH; x += HILL_SPACING) {
+        Cannon cannon = { x, WORLD_HEIGHT - 100.0f, 0.0f, -1.0f }; // Initially firing straight up
+        cannons.push_back(cannon);
+    }
+    lastFireTimes.assign(cannons.size(), GetTickCount64());
+    aimCache.assign(cannons.size(), AimSolution());
+}
 
-    // Fire from left cannon
-    if (currentTime - lastFireTimeLeft >= fireInterval) {
-        lastFireTimeLeft = currentTime;
+// Rebuild the terrain with every hill intact
+void buildTerrain() {
+    terrain.Init(WORLD_WIDTH, WORLD_HEIGHT);
+    for (const auto& cannon : cannons) {
+        terrain.AddHill(cannon.x, cannon.y, HILL_RADIUS);
+    }
+}
 
-        // Create a new cannonball from the left cannon
-        Cannonball cb;
-        cb.x = leftCannon.x + 30.0f * cos(leftCannon.angle); // Start at end of barrel
-        cb.y = leftCannon.y + 30.0f * sin(leftCannon.angle);
+// Reset game state after the player chooses to play again by restoring the
+// snapshot taken at startup
+void resetGame() {
+    SnapshotReader reader;
+    if (reader.Open(initialSnapshot.GetData(), initialSnapshot.GetSize())) restoreSnapshot(reader);
+    rewindCount = 0;
+}
 
-        // Velocity: speed of 5 units per frame towards the character
-        cb.vx = 10.0f * cos(leftCannon.angle);
-        cb.vy = 10.0f * sin(leftCannon.angle);
+// Smoke puff and flash leaving the barrel along the firing direction
+void emitMuzzleEffects(const Cannon& cannon) {
+    ParticleBurst burst;
+    burst.x = cannon.x + BARREL_LENGTH * cannon.dirX;
+    burst.y = cannon.y + BARREL_LENGTH * cannon.dirY;
+    burst.angle = FastAtan2(cannon.dirY, cannon.dirX);
+
+    burst.spread = 0.8f;
+    burst.minSpeed = 0.3f;
+    burst.maxSpeed = 1.5f;
+    burst.minLife = 40.0f;
+    burst.maxLife = 90.0f;
+    burst.color = PackPremultiplied(0.6f, 0.6f, 0.6f, 0.5f);
+    burst.count = 32;
+    smoke.Emit(burst);
+
+    burst.spread = 0.4f;
+    burst.minSpeed = 2.0f;
+    burst.maxSpeed = 5.0f;
+    burst.minLife = 4.0f;
+    burst.maxLife = 10.0f;
+    burst.color = PackPremultiplied(1.0f, 0.7f, 0.2f, 1.0f);
+    burst.count = 12;
+    sparks.Emit(burst);
+}
 
-        cannonballs.push_back(cb);
+// Debris thrown upwards plus sparks in every direction
+void emitImpactEffects(float x, float y, Pixel debrisColor) {
+    ParticleBurst burst;
+    burst.x = x;
+    burst.y = y;
+
+    burst.angle = -PI / 2.0f;
+    burst.spread = 2.5f;
+    burst.minSpeed = 1.0f;
+    burst.maxSpeed = 4.0f;
+    burst.minLife = 30.0f;
+    burst.maxLife = 70.0f;
+    burst.color = debrisColor;
+    burst.count = 40;
+    debris.Emit(burst);
+
+    burst.angle = 0.0f;
+    burst.spread = 2.0f * PI;
+    burst.minSpeed = 1.0f;
+    burst.maxSpeed = 3.0f;
+    burst.minLife = 5.0f;
+    burst.maxLife = 12.0f;
+    burst.color = PackPremultiplied(1.0f, 0.8f, 0.3f, 1.0f);
+    burst.count = 16;
+    sparks.Emit(burst);
+}
+
+// Write the whole game state. Fire times are stored as ages, since
+// GetTickCount64 values mean nothing in another run.
+void writeSnapshot(SnapshotWriter& writer, bool includeTerrain) {
+    ULONGLONG currentTime = GetTickCount64();
+    SnapshotConfig config = { WORLD_WIDTH, WORLD_HEIGHT, gravity, (uint32_t)cannons.size(), swarmMode ? 1u : 0u };
+    float character[2] = { characterPos.first, characterPos.second };
+    vector<ULONGLONG> fireAges(lastFireTimes.size());
+    for (size_t i = 0; i < lastFireTimes.size(); i++) {
+        fireAges[i] = currentTime - lastFireTimes[i];
     }
 
-    // Fire from right cannon
-    if (currentTime - lastFireTimeRight >= fireInterval) {
-        lastFireTimeRight = currentTime;
+    writer.Begin();
+    writer.WriteValue(TAG_CONFIG, config);
+    writer.WriteValue(TAG_TICK, (uint64_t)simTick);
+    writer.WriteValue(TAG_CHARACTER, character);
+    writer.WriteArray(TAG_CANNONS, cannons);
+    writer.WriteArray(TAG_FIRE_AGES, fireAges);
+    writer.WriteArray(TAG_BALL_X, cannonballs.x);
+    writer.WriteArray(TAG_BALL_Y, cannonballs.y);
+    writer.WriteArray(TAG_BALL_VX, cannonballs.vx);
+    writer.WriteArray(TAG_BALL_VY, cannonballs.vy);
+    writer.WriteArray(TAG_DORMANT, dormantCannonballs.GetDormant());
+    if (includeTerrain) writer.WriteArray(TAG_TERRAIN, terrain.GetBits());
+    if (swarmMode) {
+        writer.WriteArray(TAG_SURVIVOR_X, swarm.x);
+        writer.WriteArray(TAG_SURVIVOR_Y, swarm.y);
+        writer.WriteArray(TAG_SURVIVOR_VX, swarm.vx);
+        writer.WriteArray(TAG_SURVIVOR_VY, swarm.vy);
+        writer.WriteArray(TAG_SURVIVOR_RNG, swarm.rng);
+        writer.WriteValue(TAG_SURVIVOR_DEATHS, (uint64_t)swarm.deaths);
+    }
+    writer.End();
+}
 
-        // Create a new cannonball from the right cannon
-        Cannonball cb;
-        cb.x = rightCannon.x + 30.0f * cos(rightCannon.angle); // Start at end of barrel
-        cb.y = rightCannon.y + 30.0f * sin(rightCannon.angle);
+// Restore the state written by writeSnapshot. Every block is checked before
+// anything is restored, so a snapshot that does not fit leaves the game as is.
+// Snapshots written without the terrain take it from terrainBits instead.
+bool readSnapshot(const SnapshotReader& reader, const vector<uint64_t>* terrainBits) {
+    SnapshotConfig config;
+    if (!reader.ReadValue(TAG_CONFIG, config) ||
+        config.worldWidth != WORLD_WIDTH || config.worldHeight != WORLD_HEIGHT ||
+        config.gravity != gravity || config.cannonCount != cannons.size() ||
+        config.swarmMode != (swarmMode ? 1u : 0u)) {
+        cerr << "Snapshot was taken with different game settings." << endl;
+        return false;
+    }
 
-        // Velocity: speed of 5 units per frame towards the character
-        cb.vx = 10.0f * cos(rightCannon.angle);
-        cb.vy = 10.0f * sin(rightCannon.angle);
+    size_t size;
+    auto blockSize = [&](uint32_t tag) { return reader.FindBlock(tag, size) ? size : SIZE_MAX; };
+    size_t ballBytes = blockSize(TAG_BALL_X);
+    size_t dormantBytes = blockSize(TAG_DORMANT);
+    size_t terrainBytes = terrainBits ? terrainBits->size() * sizeof(uint64_t) : blockSize(TAG_TERRAIN);
+    bool valid = blockSize(TAG_TICK) == sizeof(uint64_t) &&
+        blockSize(TAG_CHARACTER) == 2 * sizeof(float) &&
+        blockSize(TAG_CANNONS) == cannons.size() * sizeof(Cannon) &&
+        blockSize(TAG_FIRE_AGES) == cannons.size() * sizeof(ULONGLONG) &&
+        ballBytes != SIZE_MAX && ballBytes % sizeof(float) == 0 &&
+        blockSize(TAG_BALL_Y) == ballBytes &&
+        blockSize(TAG_BALL_VX) == ballBytes &&
+        blockSize(TAG_BALL_VY) == ballBytes &&
+        dormantBytes != SIZE_MAX && dormantBytes % sizeof(DormantProjectile) == 0 &&
+        terrainBytes == terrain.GetBits().size() * sizeof(uint64_t);
+    if (valid && swarmMode) {
+        size_t survivorBytes = blockSize(TAG_SURVIVOR_X);
+        valid = survivorBytes != SIZE_MAX && survivorBytes % sizeof(float) == 0 &&
+            blockSize(TAG_SURVIVOR_Y) == survivorBytes &&
+            blockSize(TAG_SURVIVOR_VX) == survivorBytes &&
+            blockSize(TAG_SURVIVOR_VY) == survivorBytes &&
+            blockSize(TAG_SURVIVOR_RNG) == survivorBytes / sizeof(float) * sizeof(uint32_t) &&
+            blockSize(TAG_SURVIVOR_DEATHS) == sizeof(uint64_t);
+    }
+    if (!valid) {
+        cerr << "Snapshot is missing game state." << endl;
+        return false;
+    }
 
-        cannonballs.push_back(cb);
+    uint64_t tick;
+    float character[2];
+    vector<ULONGLONG> fireAges;
+    reader.ReadValue(TAG_TICK, tick);
+    reader.ReadValue(TAG_CHARACTER, character);
+    reader.ReadArray(TAG_CANNONS, cannons);
+    reader.ReadArray(TAG_FIRE_AGES, fireAges);
+    reader.ReadArray(TAG_BALL_X, cannonballs.x);
+    reader.ReadArray(TAG_BALL_Y, cannonballs.y);
+    reader.ReadArray(TAG_BALL_VX, cannonballs.vx);
+    reader.ReadArray(TAG_BALL_VY, cannonballs.vy);
+
+    // The heap and terrain blocks are used in place, without an intermediate copy
+    const void* dormant = reader.FindBlock(TAG_DORMANT, size);
+    dormantCannonballs.Restore((const DormantProjectile*)dormant, size / sizeof(DormantProjectile));
+    if (terrainBits) {
+        terrain.Restore(terrainBits->data(), terrainBits->size());
+    }
+    else {
+        const void* bits = reader.FindBlock(TAG_TERRAIN, size);
+        terrain.Restore((const uint64_t*)bits, size / sizeof(uint64_t));
     }
 
-    // Move cannonballs
-    for (auto it = cannonballs.begin(); it != cannonballs.end(); ) {
-        it->x += it->vx;
-        it->y += it->vy;
+    simTick = tick;
+    characterPos = { character[0], character[1] };
+    ULONGLONG currentTime = GetTickCount64();
+    for (size_t i = 0; i < cannons.size(); i++) {
+        lastFireTimes[i] = currentTime - fireAges[i];
+    }
+    aimCache.assign(cannons.size(), AimSolution());
+    projectileGrid.Build(cannonballs.x.data(), cannonballs.y.data(), cannonballs.Size());
+
+    if (swarmMode) {
+        uint64_t deaths;
+        reader.ReadArray(TAG_SURVIVOR_X, swarm.x);
+        reader.ReadArray(TAG_SURVIVOR_Y, swarm.y);
+        reader.ReadArray(TAG_SURVIVOR_VX, swarm.vx);
+        reader.ReadArray(TAG_SURVIVOR_VY, swarm.vy);
+        reader.ReadArray(TAG_SURVIVOR_RNG, swarm.rng);
+        reader.ReadValue(TAG_SURVIVOR_DEATHS, deaths);
+        swarm.hit.assign(swarm.Size(), 0);
+        swarm.deaths = (size_t)deaths;
+        survivorGrid.Build(swarm.x.data(), swarm.y.data(), swarm.Size());
+    }
+    return true;
+}
 
-        // Remove cannonball if it goes out of bounds
-        if (it->x < 0 || it->x > WIDTH || it->y < 0 || it->y > HEIGHT) {
-            it = cannonballs.erase(it);
+// New game and load restore through here. Particles are not part of the
+// snapshot, so the ones from the abandoned state are dropped with it. Rewind
+// reads the snapshot directly and lets the particles play on.
+bool restoreSnapshot(const SnapshotReader& reader) {
+    if (!readSnapshot(reader)) return false;
+    smoke.Clear();
+    debris.Clear();
+    sparks.Clear();
+    return true;
+}
+
+static size_t rewindSlotBytes(const RewindSlot& slot) {
+    return slot.state.GetSize() + slot.undoRows.size() * sizeof(uint32_t) + slot.undoBits.size() * sizeof(uint64_t);
+}
+
+// Add the current state to the rewind ring
+void recordRewind() {
+    const size_t wordsPerRow = terrain.GetWordsPerRow();
+    const size_t rowBytes = wordsPerRow * sizeof(uint64_t);
+
+    if (rewindCount == 0) {
+        rewindTerrain = terrain.GetBits();
+    }
+    else {
+        // Rows changed since the newest slot become its undo, then rewindTerrain catches up
+        RewindSlot& newest = rewindRing[(rewindNext + REWIND_SLOTS - 1) % REWIND_SLOTS];
+        newest.undoRows.clear();
+        newest.undoBits.clear();
+        for (int y = 0; y < terrain.GetHeight(); y++) {
+            uint64_t* saved = &rewindTerrain[(size_t)y * wordsPerRow];
+            if (memcmp(saved, terrain.GetRow(y), rowBytes) == 0) continue;
+            newest.undoRows.push_back((uint32_t)y);
+            newest.undoBits.insert(newest.undoBits.end(), saved, saved + wordsPerRow);
+            memcpy(saved, terrain.GetRow(y), rowBytes);
         }
-        else {
-            ++it;
+    }
+
+    // A full ring overwrites its oldest slot
+    writeSnapshot(rewindRing[rewindNext].state, false);
+    rewindRing[rewindNext].undoRows.clear();
+    rewindRing[rewindNext].undoBits.clear();
+    rewindNext = (rewindNext + 1) % REWIND_SLOTS;
+    if (rewindCount < REWIND_SLOTS) rewindCount++;
+
+    // Drop the oldest slots, and their memory, until the ring fits the budget
+    size_t bytes = rewindTerrain.size() * sizeof(uint64_t);
+    for (size_t i = 0; i < rewindCount; i++) {
+        bytes += rewindSlotBytes(rewindRing[(rewindNext + REWIND_SLOTS - 1 - i) % REWIND_SLOTS]);
+    }
+    while (rewindCount > 1 && bytes > REWIND_BUDGET) {
+        RewindSlot& oldest = rewindRing[(rewindNext + REWIND_SLOTS - rewindCount) % REWIND_SLOTS];
+        bytes -= rewindSlotBytes(oldest);
+        oldest = RewindSlot();
+        rewindCount--;
+    }
+}
+
+// Restore the newest slot of the rewind ring and remove it; false when it is empty
+bool stepRewind() {
+    if (rewindCount == 0) return false;
+    rewindNext = (rewindNext + REWIND_SLOTS - 1) % REWIND_SLOTS;
+    rewindCount--;
+
+    SnapshotReader reader;
+    const SnapshotWriter& snapshot = rewindRing[rewindNext].state;
+    if (reader.Open(snapshot.GetData(), snapshot.GetSize())) readSnapshot(reader, &rewindTerrain);
+
+    // rewindTerrain now has to match the slot before: undo the rows it recorded
+    if (rewindCount > 0) {
+        RewindSlot& newest = rewindRing[(rewindNext + REWIND_SLOTS - 1) % REWIND_SLOTS];
+        const size_t wordsPerRow = terrain.GetWordsPerRow();
+        for (size_t k = 0; k < newest.undoRows.size(); k++) {
+            memcpy(&rewindTerrain[(size_t)newest.undoRows[k] * wordsPerRow], &newest.undoBits[k * wordsPerRow],
+                   wordsPerRow * sizeof(uint64_t));
         }
+        newest.undoRows.clear();
+        newest.undoBits.clear();
     }
+    return true;
+}
 
-    // Handle Character Movement
+void updateParticles() {
+    smoke.Update();
+    debris.Update();
+    sparks.Update();
+}
+
+// Spawn the AI survivors for swarm mode
+void buildSwarm(size_t count) {
+    SwarmSettings settings;
+    settings.radius = SURVIVOR_RADIUS;
+    settings.hitRadius = SURVIVOR_RADIUS + CANNONBALL_RADIUS;
+    settings.maxSpeed = 4.0f;
+    settings.maxAccel = 0.6f;
+    settings.wander = 0.2f;
+    settings.threatRadius = 150.0f;
+    settings.dangerRadius = 3.0f * (SURVIVOR_RADIUS + CANNONBALL_RADIUS);
+    settings.lookahead = 20.0f;
+    settings.worldWidth = WORLD_WIDTH;
+    settings.worldHeight = WORLD_HEIGHT;
+
+    swarm.Init(count, settings, 0x9E3779B9u);
+    survivorGrid.Build(swarm.x.data(), swarm.y.data(), swarm.Size());
+}
+
+// Point every barrel at the moving target. Cached solutions are reused while the
+// target stays near the path they predicted, so most ticks skip solving. They are
+// only for drawing: a shot is solved again on the tick it is fired.
+void AimCannons(vector<Cannon>& cannons, float targetX, float targetY, float targetVx, float targetVy) {
+    for (size_t i = 0; i < cannons.size(); i++) {
+        AimWithCache(aimCache[i], simTick, cannons[i].x, cannons[i].y, BARREL_LENGTH,
+                     targetX, targetY, targetVx, targetVy, CANNONBALL_SPEED, gravity, AIM_TOLERANCE);
+        cannons[i].dirX = aimCache[i].dirX;
+        cannons[i].dirY = aimCache[i].dirY;
+    }
+}
+
+// Update Function: Handles game logic
+void update(HWND hwnd) {
+    ULONGLONG currentTime = GetTickCount64();
+    input.Drain(inputQueue);
+
+    // Save and load
+    if (input.pressed[VK_F5]) {
+        writeSnapshot(saveSnapshot);
+        saveSnapshot.SaveToFile(SAVE_FILE);
+    }
+    if (input.pressed[VK_F9]) {
+        SnapshotReader reader;
+        if (reader.OpenFile(SAVE_FILE) && restoreSnapshot(reader)) rewindCount = 0;
+        return;
+    }
+
+    // Rewind: while Backspace is held, step back one snapshot per tick instead of simulating
+    if (input.IsActive(VK_BACK)) {
+        stepRewind();
+        updateParticles();
+        return;
+    }
+
+    simTick++;
+
+    // The interest region covers every viewport position around the character
+    D2D1_RECT_F view = graphics->GetViewport();
+    float viewWidth = view.right - view.left;
+    float viewHeight = view.bottom - view.top;
+    float interestRadius = sqrtf(viewWidth * viewWidth + viewHeight * viewHeight) + INTEREST_MARGIN;
+    if (swarmMode) {
+        // Survivors are everywhere, so every cannonball stays fully simulated
+        interestRadius = sqrtf((float)WORLD_WIDTH * WORLD_WIDTH + (float)WORLD_HEIGHT * WORLD_HEIGHT);
+    }
     const float speed = 5.0f;
-    if (keys['W'] || keys[VK_UP]) {
+    const float maxCharacterStep = speed * 1.41422f; // Diagonal movement covers both axes
+
+    // Handle Character Movement
+    pair<float, float> previousPos = characterPos;
+    if (input.IsActive('W') || input.IsActive(VK_UP)) {
         characterPos.second -= speed;
         if (characterPos.second - CHARACTER_RADIUS < 0)
             characterPos.second = CHARACTER_RADIUS;
     }
-    if (keys['S'] || keys[VK_DOWN]) {
+    if (input.IsActive('S') || input.IsActive(VK_DOWN)) {
         characterPos.second += speed;
-        if (characterPos.second + CHARACTER_RADIUS > HEIGHT)
-            characterPos.second = HEIGHT - CHARACTER_RADIUS;
+        if (characterPos.second + CHARACTER_RADIUS > WORLD_HEIGHT)
+            characterPos.second = WORLD_HEIGHT - CHARACTER_RADIUS;
     }
-    if (keys['A'] || keys[VK_LEFT]) {
+    if (input.IsActive('A') || input.IsActive(VK_LEFT)) {
         characterPos.first -= speed;
         if (characterPos.first - CHARACTER_RADIUS < 0)
             characterPos.first = CHARACTER_RADIUS;
     }
-    if (keys['D'] || keys[VK_RIGHT]) {
+    if (input.IsActive('D') || input.IsActive(VK_RIGHT)) {
         characterPos.first += speed;
-        if (characterPos.first + CHARACTER_RADIUS > WIDTH)
-            characterPos.first = WIDTH - CHARACTER_RADIUS;
-    }
-
-    // Check for collisions
-    for (const auto& cb : cannonballs) {
-        float dx = cb.x - characterPos.first;
-        float dy = cb.y - characterPos.second;
-        float distance = sqrtf(dx * dx + dy * dy);
-
-        if (distance <= CHARACTER_RADIUS + 5.0f) { // 5.0f is cannonball radius
-            // Collision detected, game over
-            int response = MessageBox(hwnd, L"You were hit! Game Over.\nDo you want to play again?", L"Game Over", MB_YESNO | MB_ICONINFORMATION);
-            if (response == IDYES) {
-                // Reset game state
-                cannonballs.clear();
-                characterPos = { WIDTH / 2.0f, HEIGHT / 2.0f };
-                lastFireTimeLeft = GetTickCount64();
-                lastFireTimeRight = GetTickCount64();
-            }
-            else {
-                PostQuitMessage(0);
-            }
+        if (characterPos.first + CHARACTER_RADIUS > WORLD_WIDTH)
+            characterPos.first = WORLD_WIDTH - CHARACTER_RADIUS;
+    }
+
+    // Update cannon directions to lead the character
+    const float characterVx = characterPos.first - previousPos.first;
+    const float characterVy = characterPos.second - previousPos.second;
+    if (!swarmMode) {
+        AimCannons(cannons, characterPos.first, characterPos.second, characterVx, characterVy);
+    }
+
+    // Fire every cannon whose interval has elapsed
+    ULONGLONG interval = swarmMode ? swarmFireInterval : fireInterval;
+    for (size_t i = 0; i < cannons.size(); i++) {
+        if (currentTime - lastFireTimes[i] < interval) continue;
+        lastFireTimes[i] = currentTime;
+
+        // In swarm mode each shot picks a survivor, spread by cannon and tick
+        if (swarmMode && swarm.Size() > 0) {
+            size_t target = (size_t)((i * 2654435761u + simTick) % swarm.Size());
+            float flightTime;
+            SolveIntercept(cannons[i].x, cannons[i].y, BARREL_LENGTH,
+                           swarm.x[target], swarm.y[target], swarm.vx[target], swarm.vy[target],
+                           CANNONBALL_SPEED, gravity, cannons[i].dirX, cannons[i].dirY, flightTime);
+        }
+        // A cached aim leads the character only for a shot fired on the tick it
+        // was solved; one fired later arrives late by as many ticks
+        else if (!swarmMode) {
+            float flightTime;
+            SolveIntercept(cannons[i].x, cannons[i].y, BARREL_LENGTH,
+                           characterPos.first, characterPos.second, characterVx, characterVy,
+                           CANNONBALL_SPEED, gravity, cannons[i].dirX, cannons[i].dirY, flightTime);
+        }
+
+        // Create a new cannonball from this cannon, starting at the end of the barrel.
+        // The step adds gravity before moving, which is half a tick more drop than
+        // the continuous arc the aim solved for; launching half a tick higher cancels it.
+        const Cannon& cannon = cannons[i];
+        cannonballs.Push(
+            cannon.x + BARREL_LENGTH * cannon.dirX,
+            cannon.y + BARREL_LENGTH * cannon.dirY,
+            CANNONBALL_SPEED * cannon.dirX,
+            CANNONBALL_SPEED * cannon.dirY - 0.5f * gravity);
+        emitMuzzleEffects(cannon);
+    }
+
+    // Materialize dormant cannonballs that reached the interest region
+    dormantCannonballs.Wake(simTick, characterPos.first, characterPos.second, interestRadius, maxCharacterStep, cannonballs);
+
+    // Move, cull and collide in parallel: each chunk writes only its own balls and outcomes
+    size_t count = cannonballs.Size();
+    outcomes.resize(count);
+    const float characterX = characterPos.first;
+    const float characterY = characterPos.second;
+    const float reach = CHARACTER_RADIUS + CANNONBALL_RADIUS;
+    const float demoteRadius = interestRadius + DEMOTE_HYSTERESIS;
+
+    jobs.ParallelFor(count, PROJECTILE_CHUNK, [&](size_t begin, size_t end) {
+        float* x = cannonballs.x.data();
+        float* y = cannonballs.y.data();
+        const float* vx = cannonballs.vx.data();
+        float* vy = cannonballs.vy.data();
+
+        for (size_t i = begin; i < end; i++) {
+            vy[i] += gravity;
+            x[i] += vx[i];
+            y[i] += vy[i];
+
+            float dx = x[i] - characterX;
+            float dy = y[i] - characterY;
+            float distanceSq = dx * dx + dy * dy;
+
+            // Off-screen balls stay alive until they leave the world
+            if (x[i] < 0 || x[i] > WORLD_WIDTH || y[i] < 0 || y[i] > WORLD_HEIGHT)
+                outcomes[i] = PROJECTILE_LEFT_WORLD;
+            else if (distanceSq <= reach * reach)
+                outcomes[i] = PROJECTILE_HIT_CHARACTER;
+            else if (terrain.OverlapsCircle(x[i], y[i], CANNONBALL_RADIUS))
+                outcomes[i] = PROJECTILE_HIT_TERRAIN;
+            // Far from the character: hand over to the closed-form scheduler
+            else if (distanceSq > demoteRadius * demoteRadius)
+                outcomes[i] = PROJECTILE_DORMANT;
+            else
+                outcomes[i] = PROJECTILE_ALIVE;
+        }
+    });
+
+    // Reduce the outcomes in index order so results do not depend on scheduling
+    bool hit = false;
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint8_t outcome = outcomes[i];
+
+        // The chunks tested the terrain as it was before this tick. An earlier ball
+        // may have carved this spot away since, and then this one flies on through
+        // the fresh crater, as it did when balls were stepped one at a time.
+        if (outcome == PROJECTILE_HIT_TERRAIN &&
+            !terrain.OverlapsCircle(cannonballs.x[i], cannonballs.y[i], CANNONBALL_RADIUS)) {
+            float dx = cannonballs.x[i] - characterX;
+            float dy = cannonballs.y[i] - characterY;
+            outcome = dx * dx + dy * dy > demoteRadius * demoteRadius ? PROJECTILE_DORMANT : PROJECTILE_ALIVE;
+        }
+
+        switch (outcome) {
+        case PROJECTILE_ALIVE:
+            cannonballs.Move(i, kept++);
+            break;
+        case PROJECTILE_HIT_CHARACTER:
+            hit = true;
+            break;
+        case PROJECTILE_HIT_TERRAIN:
+            // Cannonballs that hit the ground blow a crater into it
+            terrain.Carve(cannonballs.x[i], cannonballs.y[i], CRATER_RADIUS);
+            emitImpactEffects(cannonballs.x[i], cannonballs.y[i], PackPremultiplied(0.0f, 0.5f, 0.0f, 1.0f));
+            break;
+        case PROJECTILE_DORMANT:
+            dormantCannonballs.Demote(
+                cannonballs.x[i], cannonballs.y[i], cannonballs.vx[i], cannonballs.vy[i],
+                simTick, characterX, characterY, interestRadius, maxCharacterStep);
             break;
         }
     }
+    cannonballs.Resize(kept);
+    projectileGrid.Build(cannonballs.x.data(), cannonballs.y.data(), cannonballs.Size());
+
+    // Swarm: batched steering against the threats the broadphase reports, then
+    // respawn the survivors that were hit in index order
+    if (swarmMode) {
+        jobs.ParallelFor(swarm.Size(), SWARM_CHUNK, [&](size_t begin, size_t end) {
+            swarm.Step(begin, end, cannonballs, projectileGrid, terrain);
+        });
+        for (size_t i = 0; i < swarm.Size(); i++) {
+            if (swarm.hit[i]) emitImpactEffects(swarm.x[i], swarm.y[i], PackPremultiplied(1.0f, 0.65f, 0.0f, 1.0f));
+        }
+        swarm.Respawn();
+        survivorGrid.Build(swarm.x.data(), swarm.y.data(), swarm.Size());
+    }
+
+    updateParticles();
+
+    // Keep a ring of recent states to rewind through
+    if (simTick % REWIND_INTERVAL == 0) recordRewind();
+
+    if (hit) {
+        // Collision detected, game over
+        int response = MessageBox(hwnd, L"You were hit! Game Over.\nDo you want to play again?", L"Game Over", MB_YESNO | MB_ICONINFORMATION);
+        if (response == IDYES) {
+            resetGame();
+        }
+        else {
+            PostQuitMessage(0);
+        }
+    }
+}
+
+// Static Layer: Sky and cannon bases never move, so Graphics caches them
+void renderStaticLayer(Graphics* g)
+{
+    g->ClearScreen();
+
+    // Draw Cannon Bases
+    for (const auto& cannon : cannons) {
+        g->DrawCannonBase(cannon);
+    }
 }
 
 // Render Function: Draws all game entities
 void render()
 {
     graphics->BeginDraw();
-    graphics->ClearScreen();
-
-    // Draw Hills
-    graphics->DrawHill(leftCannon.x, leftCannon.y, 100.0f); // Left hill
-    graphics->DrawHill(rightCannon.x, rightCannon.y, 100.0f); // Right hill
 
-    // Draw Cannons
-    graphics->DrawCannon(leftCannon);
-    graphics->DrawCannon(rightCannon);
+    // Center the camera on the character, clamped to the world
+    D2D1_RECT_F view = graphics->GetViewport();
+    float viewWidth = view.right - view.left;
+    float viewHeight = view.bottom - view.top;
+    float cameraX = characterPos.first - viewWidth / 2.0f;
+    float cameraY = characterPos.second - viewHeight / 2.0f;
+    if (cameraX > WORLD_WIDTH - viewWidth) cameraX = WORLD_WIDTH - viewWidth;
+    if (cameraY > WORLD_HEIGHT - viewHeight) cameraY = WORLD_HEIGHT - viewHeight;
+    if (cameraX < 0) cameraX = 0;
+    if (cameraY < 0) cameraY = 0;
+    graphics->SetCamera(cameraX, cameraY);
+    view = graphics->GetViewport();
+
+    graphics->DrawStaticLayer(renderStaticLayer);
+
+    // Draw Hills: only terrain rows carved since the last frame are re-rasterized
+    graphics->DrawTerrain(terrain);
+
+    // Draw Cannon Barrels that reach into the viewport
+    const float barrelReach = 30.0f;
+    for (const auto& cannon : cannons) {
+        if (cannon.x + barrelReach < view.left || cannon.x - barrelReach > view.right ||
+            cannon.y + barrelReach < view.top || cannon.y - barrelReach > view.bottom)
+            continue;
+        graphics->DrawCannonBarrel(cannon);
+    }
 
-    // Draw Cannonballs
-    for (const auto& cb : cannonballs) {
-        graphics->DrawCannonball(cb);
+    // Draw Cannonballs: only the grid cells overlapping the viewport are visited
+    projectileGrid.Query(
+        view.left - CANNONBALL_RADIUS, view.top - CANNONBALL_RADIUS,
+        view.right + CANNONBALL_RADIUS, view.bottom + CANNONBALL_RADIUS,
+        [&](uint32_t i) {
+            Cannonball cb = { cannonballs.x[i], cannonballs.y[i], cannonballs.vx[i], cannonballs.vy[i] };
+            graphics->DrawCannonball(cb);
+        });
+
+    // Draw Particles: each system is blended on the CPU and uploaded in one pass
+    graphics->DrawParticles(debris, 2, BLEND_OVER);
+    graphics->DrawParticles(smoke, 3, BLEND_OVER);
+    graphics->DrawParticles(sparks, 1, BLEND_ADD);
+
+    // Draw Survivors in the viewport
+    if (swarmMode) {
+        survivorGrid.Query(
+            view.left - SURVIVOR_RADIUS, view.top - SURVIVOR_RADIUS,
+            view.right + SURVIVOR_RADIUS, view.bottom + SURVIVOR_RADIUS,
+            [&](uint32_t i) { graphics->DrawSurvivor(swarm.x[i], swarm.y[i], SURVIVOR_RADIUS); });
     }
 
     // Draw Character
@@ -236,19 +898,48 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
 
     g_hwnd = windowHandle; // Assign to global variable
 
-    // Initialize Graphics
+    parseCommandLine(lpCmdLine);
+
+    // Initialize Graphics, on a Direct2D 1.1 device context with flip-model presentation
+    // when -flip is given, or rasterized on the CPU without Direct2D with -software
+    GraphicsBackend backend = GRAPHICS_BACKEND_HWND;
+    if (commandLineFlag(L"-flip")) backend = GRAPHICS_BACKEND_DEVICE_CONTEXT;
+    if (commandLineFlag(L"-software")) backend = GRAPHICS_BACKEND_SOFTWARE;
     graphics = new Graphics();
-    if (!graphics->Init(windowHandle)) {
+    if (!graphics->Init(windowHandle, backend)) {
         MessageBox(NULL, L"Graphics Initialization Failed!", L"Error", MB_ICONEXCLAMATION | MB_OK);
         delete graphics;
         return -1;
     }
+    graphics->SetStaticLayerSize(WORLD_WIDTH, WORLD_HEIGHT);
+    buildCannons();
+    buildTerrain();
+    projectileGrid.Init(WORLD_WIDTH, WORLD_HEIGHT, GRID_CELL_SIZE);
+    jobs.Init();
+    smoke.Init(SMOKE_CAPACITY, -0.01f, 0.96f, 0x2545F491u);
+    debris.Init(DEBRIS_CAPACITY, 0.15f, 0.99f, 0x9E3779B9u);
+    sparks.Init(SPARK_CAPACITY, 0.0f, 0.9f, 0x6C8E9CF5u);
+
+    // Ballistic cannonballs from the command line: -gravity [g]
+    double gravityArg = 0.0;
+    if (commandLineFlag(L"-gravity", &gravityArg)) {
+        gravity = gravityArg > 0.0 ? (float)gravityArg : DEFAULT_GRAVITY;
+    }
+    dormantCannonballs.Init(WORLD_WIDTH, WORLD_HEIGHT, gravity);
+
+    // Swarm mode from the command line: -swarm [count]
+    double swarmArg = 0.0;
+    if (commandLineFlag(L"-swarm", &swarmArg)) {
+        swarmMode = true;
+        survivorGrid.Init(WORLD_WIDTH, WORLD_HEIGHT, GRID_CELL_SIZE);
+        buildSwarm(swarmArg >= 1.0 ? (size_t)swarmArg : DEFAULT_SWARM_SIZE);
+    }
 
     ShowWindow(windowHandle, nShowCmd);
 
-    // Initialize firing times
-    lastFireTimeLeft = GetTickCount64();
-    lastFireTimeRight = GetTickCount64();
+    // Initialize firing times, then capture the starting state for resets
+    lastFireTimes.assign(cannons.size(), GetTickCount64());
+    writeSnapshot(initialSnapshot);
 
     // Main Message Loop
     MSG message;
@@ -265,6 +956,7 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     }
 
     // Cleanup
+    jobs.Shutdown();
     delete graphics;
 
     return (int)message.wParam;